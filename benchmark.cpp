@@ -0,0 +1,357 @@
+#include "datapacklib_host.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Замеры производительности кодера и декодера. Вывод в духе Google Benchmark:
+// имя, время на операцию, на символ (переход) и пропускная способность по
+// полезным данным. Аргумент командной строки - подстрока для выбора замеров.
+//
+//   g++ -std=c++17 -O2 -march=native benchmark.cpp -o datapack_bench
+//   ./datapack_bench decode
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Не даёт компилятору выбросить результат замера
+    template <typename T>
+    inline void keep(const T &value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        static volatile const void *sink;
+        sink = &value;
+#endif
+    }
+
+    const char *g_filter = nullptr;
+
+    // Повторяет body, пока не наберётся ~0.2 с. body возвращает обработанные
+    // (символы, байты полезных данных) за один прогон.
+    template <typename Body>
+    void run(const std::string &name, Body &&body)
+    {
+        if (g_filter && name.find(g_filter) == std::string::npos)
+            return;
+        std::size_t symbols = 0;
+        std::size_t bytes = 0;
+        std::size_t iterations = 0;
+        const auto start = Clock::now();
+        double elapsed = 0;
+        while (elapsed < 0.2)
+        {
+            const auto done = body();
+            symbols += done.first;
+            bytes += done.second;
+            ++iterations;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        const double ns = elapsed * 1e9;
+        std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << ns / iterations << " ns/op" << std::setw(9) << std::setprecision(2)
+                  << (symbols ? ns / symbols : 0.0) << " ns/sym" << std::setw(10) << std::setprecision(1)
+                  << (bytes ? bytes / elapsed / 1e6 : 0.0) << " MB/s" << std::endl;
+    }
+
+    std::vector<uint8_t> randomBytes(std::size_t len, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> data(len);
+        for (uint8_t &byte : data)
+            byte = static_cast<uint8_t>(rng());
+        return data;
+    }
+
+    // Поток из messages сообщений по len байт; с noise часть переходов портится
+    std::vector<datapack::SignalChange> makeTrace(const datapack::ProtocolConfig &config, std::size_t messages,
+                                                  std::size_t len, bool noise, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::vector<datapack::SignalChange> trace;
+        datapack::SignalBuffer out;
+        for (std::size_t m = 0; m < messages; ++m)
+        {
+            const std::vector<uint8_t> data = randomBytes(len, seed + static_cast<uint32_t>(m));
+            datapack::Encoder(config).encode(data.data(), data.size(), out);
+            for (std::size_t i = 0; i < out.size(); ++i)
+            {
+                datapack::SignalChange sc = out[i];
+                if (noise)
+                {
+                    const uint32_t r = rng() % 1000;
+                    if (r < 5)
+                        sc.duration = static_cast<long>(rng() % config.min_duration); // глитч
+                    else if (r < 10)
+                        sc.value = datapack::levels[rng() % 5]; // перепутан цвет
+                }
+                trace.push_back(sc);
+            }
+        }
+        return trace;
+    }
+
+    void countPacket(const datapack::UnpackedPackage &, void *context) { ++*static_cast<std::size_t *>(context); }
+
+    void countChannelPacket(std::size_t, const datapack::UnpackedPackage &, void *context)
+    {
+        ++*static_cast<std::size_t *>(context);
+    }
+
+    void benchCrc()
+    {
+        uint32_t packets[4096];
+        std::mt19937 rng(1);
+        for (uint32_t &packet : packets)
+            packet = rng();
+        run("crs8", [&] {
+            uint8_t acc = 0;
+            for (uint32_t packet : packets)
+                acc ^= datapack::crs8(static_cast<uint16_t>(packet), static_cast<uint8_t>(packet >> 16));
+            keep(acc);
+            return std::make_pair(std::size_t(0), sizeof(packets));
+        });
+        run("unpack_and_check", [&] {
+            std::size_t valid = 0;
+            for (uint32_t packet : packets)
+                valid += datapack::unpack_and_check(packet).valid;
+            keep(valid);
+            return std::make_pair(std::size_t(0), sizeof(packets));
+        });
+    }
+
+    void benchEncode()
+    {
+        for (std::size_t len : {16u, 64u, 256u, 512u})
+        {
+            const std::vector<uint8_t> data = randomBytes(len, 2);
+            datapack::SignalBuffer out;
+            run("encode/" + std::to_string(len), [&] {
+                datapack::Encoder().encode(data.data(), data.size(), out);
+                keep(out);
+                return std::make_pair(out.size(), data.size());
+            });
+        }
+
+        const std::vector<uint8_t> data = randomBytes(512, 3);
+        run("encode/legacy_setSendData/512", [&] {
+            datapack::setSendData(data.data(), data.size());
+            keep(datapack::send_commands);
+            return std::make_pair(datapack::send_commands.size(), data.size());
+        });
+        run("encodeTo/callable/512", [&] {
+            std::size_t symbols = 0;
+            long total = 0;
+            datapack::Encoder().encodeTo(data.data(), data.size(), [&](const datapack::SignalChange &sc) {
+                total += sc.duration;
+                ++symbols;
+            });
+            keep(total);
+            return std::make_pair(symbols, data.size());
+        });
+        run("StreamEncoder/512", [&] {
+            datapack::StreamEncoder encoder;
+            encoder.start(data.data(), data.size());
+            datapack::SignalChange chunk[64];
+            std::size_t symbols = 0;
+            while (std::size_t n = encoder.next(chunk, 64))
+                symbols += n;
+            keep(chunk);
+            return std::make_pair(symbols, data.size());
+        });
+
+        // маяк: 400 байт, меняется одно слово
+        std::vector<uint8_t> status = randomBytes(400, 9);
+        datapack::Encoder::Signals beacon;
+        datapack::Encoder().encode(status.data(), status.size(), beacon);
+        std::size_t patch = 0;
+        run("encode/update_word/400", [&] {
+            patch = (patch + 37) % status.size();
+            status[patch] ^= 0x5A;
+            datapack::Encoder().update(status.data(), status.size(), patch, 1, beacon);
+            keep(beacon);
+            return std::make_pair(datapack::kSymbolsPerPacket, std::size_t(2));
+        });
+
+        datapack::ProtocolConfig fec;
+        fec.fec_group = 8;
+        const std::vector<uint8_t> fecData = randomBytes(384, 4);
+        run("encode/fec8/384", [&] {
+            datapack::SignalBuffer out;
+            datapack::Encoder(fec).encode(fecData.data(), fecData.size(), out);
+            keep(out);
+            return std::make_pair(out.size(), fecData.size());
+        });
+    }
+
+    void benchDecode()
+    {
+        struct Case
+        {
+            const char *name;
+            datapack::ProtocolConfig config;
+            bool noise;
+        };
+        datapack::ProtocolConfig sync;
+        sync.frame_sync = true;
+        datapack::ProtocolConfig intensity;
+        intensity.modulation = datapack::Modulation::Intensity4;
+        intensity.frame_sync = true;
+        datapack::ProtocolConfig tracking;
+        tracking.clock_recovery = true;
+        const Case cases[] = {
+            {"clean", datapack::ProtocolConfig(), false},
+            {"noisy", datapack::ProtocolConfig(), true},
+            {"frame_sync/noisy", sync, true},
+            {"intensity4/noisy", intensity, true},
+            {"clock_recovery/clean", tracking, false},
+        };
+        for (const Case &c : cases)
+        {
+            const auto trace = makeTrace(c.config, 16, 512, c.noise, 5);
+            // полезных байт: 2 на слово, слово на пакет
+            const std::size_t bytes = trace.size() / datapack::symbolsPerPacket(c.config) * 2;
+            run(std::string("feed/bulk/") + c.name, [&] {
+                datapack::Decoder decoder(nullptr, nullptr, c.config);
+                const std::size_t found = decoder.feed(trace.data(), trace.size());
+                keep(found);
+                return std::make_pair(trace.size(), bytes);
+            });
+        }
+
+        const auto trace = makeTrace(datapack::ProtocolConfig(), 16, 512, false, 6);
+        const std::size_t bytes = trace.size() / datapack::kSymbolsPerPacket * 2;
+        run("feed/bulk/statistics/clean", [&] {
+            datapack::BasicDecoder<datapack::InstrumentedProtocol> decoder;
+            const std::size_t found = decoder.feed(trace.data(), trace.size());
+            keep(found);
+            keep(decoder.statistics());
+            return std::make_pair(trace.size(), bytes);
+        });
+        run("feed/per_symbol/clean", [&] {
+            datapack::Decoder decoder;
+            std::size_t found = 0;
+            for (const datapack::SignalChange &sc : trace)
+                found += decoder.feed(sc);
+            keep(found);
+            return std::make_pair(trace.size(), bytes);
+        });
+        run("feed/legacy_global/clean", [&] {
+            datapack::feed(trace.data(), trace.size());
+            return std::make_pair(trace.size(), bytes);
+        });
+
+        // цена доставки пакета приложению
+        run("feed/callback/clean", [&] {
+            std::size_t count = 0;
+            datapack::Decoder decoder(countPacket, &count);
+            decoder.feed(trace.data(), trace.size());
+            keep(count);
+            return std::make_pair(trace.size(), bytes);
+        });
+        run("feed/queue/clean", [&] {
+            static datapack::PacketQueue queue;
+            std::size_t count = 0;
+            datapack::Decoder decoder;
+            decoder.setQueue(&queue);
+            // очередь разбирается по ходу, как это делал бы поток приложения
+            for (std::size_t first = 0; first < trace.size(); first += 1024)
+            {
+                const std::size_t n = trace.size() - first < 1024 ? trace.size() - first : 1024;
+                decoder.feed(trace.data() + first, n);
+                datapack::drainPackets(queue, countPacket, &count);
+            }
+            keep(count);
+            return std::make_pair(trace.size(), bytes);
+        });
+    }
+
+    void benchChannel()
+    {
+        const auto trace = makeTrace(datapack::ProtocolConfig(), 4, 512, false, 8);
+        datapack::ChannelParams params;
+        params.drop = 0.002;
+        params.glitch = 0.01;
+        params.confusion = 0.002;
+        params.jitter = 0.05;
+        params.drift = 1e-7;
+        datapack::ChannelModel channel(params);
+        run("channel/transmit", [&] {
+            long total = 0;
+            std::size_t symbols = 0;
+            auto sink = [&](const datapack::SignalChange &sc) {
+                total += sc.duration;
+                ++symbols;
+            };
+            channel.transmit(trace.data(), trace.size(), sink);
+            channel.flush(sink);
+            keep(total);
+            return std::make_pair(symbols, trace.size() / datapack::kSymbolsPerPacket * 2);
+        });
+        datapack::ProtocolConfig sync;
+        sync.frame_sync = true;
+        run("channel/simulateLink/frame_sync/256", [&] {
+            const datapack::LinkStats stats = datapack::simulateLink(sync, params, 8, 256);
+            keep(stats);
+            return std::make_pair(stats.words * datapack::kSymbolsPerPacket, stats.words * 2);
+        });
+    }
+
+    template <std::size_t Channels>
+    void benchMulti(const std::vector<datapack::SignalChange> &trace)
+    {
+        const std::size_t steps = trace.size();
+        // переходы всех каналов по шагам, как их отдаёт многоканальный АЦП; каналы сдвинуты
+        // друг относительно друга, чтобы пакеты не совпадали по времени
+        std::vector<datapack::SignalChange> interleaved(steps * Channels);
+        for (std::size_t i = 0; i < steps; ++i)
+        {
+            for (std::size_t c = 0; c < Channels; ++c)
+                interleaved[i * Channels + c] = trace[(i + c * 7) % steps];
+        }
+        const std::size_t bytes = steps / datapack::kSymbolsPerPacket * 2 * Channels;
+        run("multi/" + std::to_string(Channels), [&] {
+            std::size_t count = 0;
+            datapack::MultiDecoder<Channels> decoder(countChannelPacket, &count);
+            for (std::size_t i = 0; i < steps; ++i)
+                decoder.feed(interleaved.data() + i * Channels);
+            keep(count);
+            return std::make_pair(steps * Channels, bytes);
+        });
+        run("multi/per_channel_decoder/" + std::to_string(Channels), [&] {
+            std::size_t count = 0;
+            for (std::size_t c = 0; c < Channels; ++c)
+            {
+                datapack::Decoder decoder(countPacket, &count);
+                decoder.feed(trace.data(), trace.size());
+            }
+            keep(count);
+            return std::make_pair(steps * Channels, bytes);
+        });
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        g_filter = argv[1];
+
+    benchCrc();
+    benchEncode();
+    benchDecode();
+    benchChannel();
+
+    const auto trace = makeTrace(datapack::ProtocolConfig(), 4, 512, true, 7);
+    benchMulti<1>(trace);
+    benchMulti<4>(trace);
+    benchMulti<8>(trace);
+    benchMulti<16>(trace);
+    benchMulti<32>(trace);
+    return 0;
+}
@@ -5,9 +5,57 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <functional>
+#include <iterator>
+#include <type_traits>
+#if __has_include(<version>)
+#include <version>
+#endif
+#ifdef __cpp_lib_span
+#include <span>
+#endif
+
+// Векторные ядра MultiDecoder; DATAPACK_NO_SIMD оставляет только скалярное.
+// Если сборка не разрешает AVX2 (x86-64 по умолчанию), GCC и Clang собирают ядро
+// с target-атрибутом, а MultiDecoder включает его, если процессор умеет AVX2.
+#if !defined(DATAPACK_NO_SIMD) && !defined(__AVX2__) && (defined(__x86_64__) || defined(__i386__)) &&          \
+    (defined(__GNUC__) || defined(__clang__))
+#define DATAPACK_SIMD_DISPATCH 1
+#define DATAPACK_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DATAPACK_SIMD_DISPATCH 0
+#define DATAPACK_TARGET_AVX2
+#endif
+#if !defined(DATAPACK_NO_SIMD) && (defined(__AVX2__) || DATAPACK_SIMD_DISPATCH)
+#define DATAPACK_SIMD_AVX2 1
+#include <immintrin.h>
+#else
+#define DATAPACK_SIMD_AVX2 0
+#endif
+#if !defined(DATAPACK_NO_SIMD) && !DATAPACK_SIMD_AVX2 && defined(__ARM_NEON) && defined(__aarch64__)
+#define DATAPACK_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define DATAPACK_SIMD_NEON 0
+#endif
+
+// Порядок байт совпадает с порядком в пакете: буфер слов можно читать как байты
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+#define DATAPACK_LITTLE_ENDIAN (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#elif defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM) || defined(_M_ARM64)
+#define DATAPACK_LITTLE_ENDIAN 1
+#else
+#define DATAPACK_LITTLE_ENDIAN 0
+#endif
+
+// 1 - декодеры с протоколом по умолчанию (и глобальный feed) пишут трассу setTrace
+#ifndef DATAPACK_TRACE
+#define DATAPACK_TRACE 0
+#endif
 
 /*
     Структура пакета данных:
@@ -18,9 +66,6 @@
 
 namespace datapack
 {
-    int min_duration = 60; // порог игнора
-    int duration = 125;    // продолжительность каждого сигнала
-
     template <typename T, std::size_t Capacity>
     class StaticVector
     {
@@ -65,29 +110,120 @@ namespace datapack
 
         const T *data() const noexcept { return data_; }
 
+        // O(Capacity) при заполненном буфере; для истории значений см. RingBuffer
         void shift_and_push(const T &value) noexcept
         {
-            if (size_ > 0)
+            if (size_ < Capacity)
             {
-                for (std::size_t i = 0; i < size_ - 1; ++i)
-                {
-                    data_[i] = data_[i + 1];
-                }
+                data_[size_] = value;
+                ++size_;
+                return;
+            }
+            for (std::size_t i = 0; i < Capacity - 1; ++i)
+            {
+                data_[i] = data_[i + 1];
             }
+            data_[Capacity - 1] = value;
+        }
+
+    private:
+        T data_[Capacity];
+        std::size_t size_;
+    };
+
+    // Кольцевой буфер фиксированной ёмкости с тем же интерфейсом, что у StaticVector.
+    // push_back при заполнении вытесняет самый старый элемент за O(1) - замена
+    // shift_and_push для истории последних значений. Индекс 0 - самый старый.
+    template <typename T, std::size_t Capacity>
+    class RingBuffer
+    {
+    public:
+        // Содержимое в порядке от старого к новому - не больше двух непрерывных кусков
+        struct Spans
+        {
+            const T *first;
+            std::size_t first_size;
+            const T *second;
+            std::size_t second_size;
+        };
+
+        RingBuffer() noexcept : head_(0), size_(0), dropped_(0) {}
+
+        std::size_t size() const noexcept { return size_; }
+
+        constexpr std::size_t capacity() const noexcept { return Capacity; }
+
+        bool full() const noexcept { return size_ == Capacity; }
+
+        // Сколько элементов вытеснено с последнего clear()
+        std::size_t dropped() const noexcept { return dropped_; }
+
+        // Всегда сохраняет элемент и возвращает true, как StaticVector::push_back при
+        // наличии места; вытеснение старого элемента видно по dropped()
+        bool push_back(const T &value) noexcept
+        {
+            std::size_t tail = head_ + size_;
+            if (tail >= Capacity)
+                tail -= Capacity;
+            data_[tail] = value;
             if (size_ < Capacity)
             {
-                data_[size_] = value;
                 ++size_;
+                return true;
             }
-            else
+            if (++head_ == Capacity)
+                head_ = 0;
+            ++dropped_;
+            return true;
+        }
+
+        void clear() noexcept
+        {
+            head_ = 0;
+            size_ = 0;
+            dropped_ = 0;
+        }
+
+        T &operator[](std::size_t index) noexcept { return data_[physical(index)]; }
+
+        const T &operator[](std::size_t index) const noexcept { return data_[physical(index)]; }
+
+        T &back() noexcept { return (*this)[size_ - 1]; }
+
+        const T &back() const noexcept { return (*this)[size_ - 1]; }
+
+        Spans spans() const noexcept
+        {
+            const std::size_t first_size = (head_ + size_ > Capacity) ? Capacity - head_ : size_;
+            return {data_ + head_, first_size, data_, size_ - first_size};
+        }
+
+        // Копирует содержимое (от старого к новому) в out, возвращает число элементов
+        std::size_t copyTo(T *out) const noexcept
+        {
+            const Spans parts = spans();
+            for (std::size_t i = 0; i < parts.first_size; ++i)
             {
-                data_[Capacity - 1] = value;
+                out[i] = parts.first[i];
             }
+            for (std::size_t i = 0; i < parts.second_size; ++i)
+            {
+                out[parts.first_size + i] = parts.second[i];
+            }
+            return size_;
         }
 
     private:
+        std::size_t physical(std::size_t index) const noexcept
+        {
+            std::size_t position = head_ + index;
+            return position >= Capacity ? position - Capacity : position;
+        }
+
         T data_[Capacity];
+        std::size_t head_;
         std::size_t size_;
+        std::size_t dropped_;
     };
 
     struct UnpackedPackage
@@ -95,6 +231,7 @@ namespace datapack
         bool valid;
         uint8_t index;
         uint16_t word;
+        uint8_t segment; // номер сегмента из 256 пакетов (потоковый режим)
     };
 
     enum class LightLevel
@@ -106,7 +243,7 @@ namespace datapack
         Blue = 4
     };
 
-    LightLevel levels[5] = {LightLevel::Off, LightLevel::White, LightLevel::Red, LightLevel::Green, LightLevel::Blue};
+    inline constexpr LightLevel levels[5] = {LightLevel::Off, LightLevel::White, LightLevel::Red, LightLevel::Green, LightLevel::Blue};
 
     struct SignalChange
     {
@@ -114,224 +251,313 @@ namespace datapack
         long duration;
     };
 
-    StaticVector<SignalChange, 4096> send_commands;
-    static StaticVector<uint16_t, 256> send_buffer;
-    static uint16_t receive_buffer[256];
-    static uint32_t window = 12345678;
-    static void (*onPacketReceived)(UnpackedPackage) = nullptr;
-
-    int8_t getDbit(LightLevel prev, LightLevel curr)
+    namespace detail
     {
-        switch (prev)
-        {
-        case LightLevel::Off:
+        constexpr std::size_t kLevelCount = 5;
+
+        // Правила перехода: какой ди-бит несёт смена prev -> curr.
+        // Из них на этапе компиляции строятся таблицы ниже.
+        constexpr int8_t dbitRule(LightLevel prev, LightLevel curr)
         {
-            switch (curr)
+            switch (prev)
             {
             case LightLevel::Off:
-            case LightLevel::White:
-                return 0;
-            case LightLevel::Red:
-                return 1;
-            case LightLevel::Green:
-                return 2;
-            case LightLevel::Blue:
-                return 3;
-            default:
-                return 0;
-            }
-        }
-        case LightLevel::White:
-        {
-            switch (curr)
             {
-            case LightLevel::White:
-            case LightLevel::Off:
-                return 0;
-            case LightLevel::Red:
-                return 1;
-            case LightLevel::Green:
-                return 2;
-            case LightLevel::Blue:
-                return 3;
-            default:
-                return 0;
+                switch (curr)
+                {
+                case LightLevel::Off:
+                case LightLevel::White:
+                    return 0;
+                case LightLevel::Red:
+                    return 1;
+                case LightLevel::Green:
+                    return 2;
+                case LightLevel::Blue:
+                    return 3;
+                default:
+                    return 0;
+                }
             }
-        }
-        case LightLevel::Red:
-        {
-            switch (curr)
+            case LightLevel::White:
             {
+                switch (curr)
+                {
+                case LightLevel::White:
+                case LightLevel::Off:
+                    return 0;
+                case LightLevel::Red:
+                    return 1;
+                case LightLevel::Green:
+                    return 2;
+                case LightLevel::Blue:
+                    return 3;
+                default:
+                    return 0;
+                }
+            }
             case LightLevel::Red:
-            case LightLevel::Off:
-                return 0;
-            case LightLevel::White:
-                return 1;
+            {
+                switch (curr)
+                {
+                case LightLevel::Red:
+                case LightLevel::Off:
+                    return 0;
+                case LightLevel::White:
+                    return 1;
+                case LightLevel::Green:
+                    return 2;
+                case LightLevel::Blue:
+                    return 3;
+                default:
+                    return 0;
+                }
+            }
             case LightLevel::Green:
-                return 2;
+            {
+                switch (curr)
+                {
+                case LightLevel::Green:
+                case LightLevel::Off:
+                    return 0;
+                case LightLevel::White:
+                    return 1;
+                case LightLevel::Red:
+                    return 2;
+                case LightLevel::Blue:
+                    return 3;
+                default:
+                    return 0;
+                }
+            }
             case LightLevel::Blue:
-                return 3;
-            default:
-                return 0;
+            {
+                switch (curr)
+                {
+                case LightLevel::Blue:
+                case LightLevel::Off:
+                    return 0;
+                case LightLevel::White:
+                    return 1;
+                case LightLevel::Red:
+                    return 2;
+                case LightLevel::Green:
+                    return 3;
+                default:
+                    return 0;
+                }
+            }
             }
+            return 0;
         }
-        case LightLevel::Green:
+
+        struct DbitTable
+        {
+            int8_t value[kLevelCount][kLevelCount];
+        };
+
+        struct LightTable
+        {
+            LightLevel value[kLevelCount][4];
+        };
+
+        constexpr DbitTable makeDbitTable()
         {
-            switch (curr)
+            DbitTable table{};
+            for (std::size_t p = 0; p < kLevelCount; ++p)
             {
-            case LightLevel::Green:
-            case LightLevel::Off:
-                return 0;
-            case LightLevel::White:
-                return 1;
-            case LightLevel::Red:
-                return 2;
-            case LightLevel::Blue:
-                return 3;
-            default:
-                return 0;
+                for (std::size_t c = 0; c < kLevelCount; ++c)
+                {
+                    table.value[p][c] = dbitRule(static_cast<LightLevel>(p), static_cast<LightLevel>(c));
+                }
             }
+            return table;
         }
-        case LightLevel::Blue:
+
+        // Для каждого prev и ди-бита берём первый уровень (в порядке levels), отличный от prev,
+        // который декодируется в этот ди-бит.
+        constexpr LightTable makeLightTable()
         {
-            switch (curr)
+            LightTable table{};
+            for (std::size_t p = 0; p < kLevelCount; ++p)
             {
-            case LightLevel::Blue:
-            case LightLevel::Off:
-                return 0;
-            case LightLevel::White:
-                return 1;
-            case LightLevel::Red:
-                return 2;
-            case LightLevel::Green:
-                return 3;
-            default:
-                return 0;
+                for (std::size_t d = 0; d < 4; ++d)
+                {
+                    table.value[p][d] = LightLevel::Off;
+                    for (std::size_t c = 0; c < kLevelCount; ++c)
+                    {
+                        if (c != p && dbitRule(static_cast<LightLevel>(p), static_cast<LightLevel>(c)) == static_cast<int8_t>(d))
+                        {
+                            table.value[p][d] = static_cast<LightLevel>(c);
+                            break;
+                        }
+                    }
+                }
             }
+            return table;
         }
-        }
-        return 0;
+
+        inline constexpr DbitTable kDbitTable = makeDbitTable();
+        inline constexpr LightTable kLightTable = makeLightTable();
+    }
+
+    constexpr int8_t getDbit(LightLevel prev, LightLevel curr)
+    {
+        const std::size_t p = static_cast<std::size_t>(prev);
+        const std::size_t c = static_cast<std::size_t>(curr);
+        if (p >= detail::kLevelCount || c >= detail::kLevelCount)
+            return 0;
+        return detail::kDbitTable.value[p][c];
     }
 
-    LightLevel getLightForDbit(LightLevel prev, uint8_t data)
+    constexpr LightLevel getLightForDbit(LightLevel prev, uint8_t data)
     {
+        const std::size_t p = static_cast<std::size_t>(prev);
+        if (p >= detail::kLevelCount)
+            return LightLevel::Off;
         if (data > 3)
             data = 3;
-        for (LightLevel ll : levels)
-        {
-            if (ll == prev)
-                continue;
-            uint8_t expectedData = getDbit(prev, ll);
-            if (data == expectedData)
-                return ll;
-        }
-        return LightLevel::Off;
+        return detail::kLightTable.value[p][data];
     }
 
-    static uint8_t crs8(uint16_t data, uint8_t index)
+    namespace detail
     {
-        uint8_t bytes[3] = {static_cast<uint8_t>(data & 0xFF), static_cast<uint8_t>((data >> 8) & 0xFF), index};
-        uint8_t crc = 0;
-        for (int i = 0; i < 3; ++i)
+        // Четыре уровня, которыми кодируется байт (старшая пара битов первой).
+        // Последний из них - уровень, от которого продолжается цепочка.
+        struct ByteSymbols
+        {
+            uint8_t level[4];
+        };
+
+        struct ByteTable
+        {
+            ByteSymbols value[kLevelCount][256];
+        };
+
+        constexpr ByteTable makeByteTable()
         {
-            crc ^= bytes[i];
-            for (int j = 0; j < 8; ++j)
+            ByteTable table{};
+            for (std::size_t p = 0; p < kLevelCount; ++p)
             {
-                if (crc & 0x80)
-                {
-                    crc = (crc << 1) ^ 0x07;
-                }
-                else
+                for (std::size_t b = 0; b < 256; ++b)
                 {
-                    crc <<= 1;
+                    std::size_t prev = p;
+                    for (int bitpair = 3; bitpair >= 0; --bitpair)
+                    {
+                        const std::size_t twobits = (b >> (bitpair * 2)) & 0x03;
+                        prev = static_cast<std::size_t>(kLightTable.value[prev][twobits]);
+                        table.value[p][b].level[3 - bitpair] = static_cast<uint8_t>(prev);
+                    }
                 }
             }
+            return table;
         }
-        return crc;
+
+        inline constexpr ByteTable kByteTable = makeByteTable();
     }
 
-    static void encode()
+    // Кодирует байт четырьмя переходами в out, возвращает последний уровень.
+    inline LightLevel encodeByte(LightLevel prev, uint8_t byte, long symbolDuration, SignalChange *out) noexcept
     {
-        LightLevel prevValue = LightLevel::Off;
-        send_commands.clear();
-        for (size_t i = 0; i < send_buffer.size(); i++)
-        {
-            uint8_t index = i;
-            uint16_t data = send_buffer[i];
-            uint8_t crc = crs8(data, index);
+        std::size_t p = static_cast<std::size_t>(prev);
+        if (p >= detail::kLevelCount)
+            p = static_cast<std::size_t>(LightLevel::Off);
+        const detail::ByteSymbols &symbols = detail::kByteTable.value[p][byte];
+        out[0] = {static_cast<LightLevel>(symbols.level[0]), symbolDuration};
+        out[1] = {static_cast<LightLevel>(symbols.level[1]), symbolDuration};
+        out[2] = {static_cast<LightLevel>(symbols.level[2]), symbolDuration};
+        out[3] = {static_cast<LightLevel>(symbols.level[3]), symbolDuration};
+        return out[3].value;
+    }
 
-            // Кодируем index (1 байт)
-            for (int bitpair = 3; bitpair >= 0; --bitpair)
-            {
-                uint8_t twobits = (index >> (bitpair * 2)) & 0x03;
-                LightLevel next = getLightForDbit(prevValue, twobits);
-                send_commands.push_back({next, duration});
-                prevValue = next;
-            }
+    namespace detail
+    {
+        struct CrcTable
+        {
+            uint8_t value[256];
+        };
 
-            // Кодируем data low byte (1 байт)
-            uint8_t data_low = data & 0xFF;
-            for (int bitpair = 3; bitpair >= 0; --bitpair)
+        // CRC-8 с полиномом polynomial, начальное значение 0
+        constexpr CrcTable makeCrcTable(uint8_t polynomial)
+        {
+            CrcTable table{};
+            for (std::size_t b = 0; b < 256; ++b)
             {
-                uint8_t twobits = (data_low >> (bitpair * 2)) & 0x03;
-                LightLevel next = getLightForDbit(prevValue, twobits);
-                send_commands.push_back({next, duration});
-                prevValue = next;
+                uint8_t crc = static_cast<uint8_t>(b);
+                for (int j = 0; j < 8; ++j)
+                {
+                    crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ polynomial) : static_cast<uint8_t>(crc << 1);
+                }
+                table.value[b] = crc;
             }
+            return table;
+        }
 
-            // Кодируем data high byte (1 байт)
-            uint8_t data_high = (data >> 8) & 0xFF;
-            for (int bitpair = 3; bitpair >= 0; --bitpair)
-            {
-                uint8_t twobits = (data_high >> (bitpair * 2)) & 0x03;
-                LightLevel next = getLightForDbit(prevValue, twobits);
-                send_commands.push_back({next, duration});
-                prevValue = next;
-            }
+        // При нулевом начальном значении CRC линейна, поэтому вклад каждого байта
+        // пакета считается независимо: slice[k][b] - CRC байта b, за которым идут
+        // ещё 2 - k нулевых байта (slicing-by-3).
+        struct CrcSlices
+        {
+            uint8_t value[3][256];
+        };
 
-            // Кодируем crc (1 байт)
-            for (int bitpair = 3; bitpair >= 0; --bitpair)
+        constexpr CrcSlices makeCrcSlices(const CrcTable &table)
+        {
+            CrcSlices slices{};
+            for (std::size_t b = 0; b < 256; ++b)
             {
-                uint8_t twobits = (crc >> (bitpair * 2)) & 0x03;
-                LightLevel next = getLightForDbit(prevValue, twobits);
-                send_commands.push_back({next, duration});
-                prevValue = next;
+                const uint8_t once = table.value[b];
+                const uint8_t twice = table.value[once];
+                slices.value[0][b] = table.value[twice];
+                slices.value[1][b] = twice;
+                slices.value[2][b] = once;
             }
+            return slices;
         }
+
+        // Таблицы создаются один раз на каждый используемый полином
+        template <uint8_t Polynomial>
+        struct Crc8
+        {
+            static constexpr CrcTable table = makeCrcTable(Polynomial);
+            static constexpr CrcSlices slices = makeCrcSlices(table);
+        };
     }
 
-    void setSendData(const uint8_t *data, size_t len)
+    constexpr uint8_t kCrcPolynomial = 0x07; // полином по умолчанию
+
+    namespace detail
     {
-        send_buffer.clear();
-        if (len > send_buffer.capacity())
-            len = send_buffer.capacity();
-        for (size_t i = 0; i < len; i += 2)
-        {
-            uint16_t word = data[i];
-            if (i + 1 < len)
-            {
-                word |= (static_cast<uint16_t>(data[i + 1]) << 8);
-            }
-            send_buffer.push_back(word);
-        }
-        encode();
+        inline constexpr const CrcTable &kCrcTable = Crc8<kCrcPolynomial>::table;
+        inline constexpr const CrcSlices &kCrcSlices = Crc8<kCrcPolynomial>::slices;
     }
 
-    size_t getReceivedData(uint8_t *data)
+    // Побайтовое продолжение CRC-8 для потоковых данных
+    template <uint8_t Polynomial = kCrcPolynomial>
+    constexpr uint8_t crc8Update(uint8_t crc, uint8_t byte)
     {
-        size_t index = 0;
-        for (size_t i = 0; i < sizeof(receive_buffer) / sizeof(uint16_t); ++i)
-        {
-            uint16_t word = receive_buffer[i];
-            data[index++] = word & 0xFF;
-            data[index++] = (word >> 8) & 0xFF;
-        }
-        return index;
+        return detail::Crc8<Polynomial>::table.value[crc ^ byte];
+    }
+
+    // CRC по байтам data low, data high, index
+    template <uint8_t Polynomial = kCrcPolynomial>
+    constexpr uint8_t crs8(uint16_t data, uint8_t index)
+    {
+        return detail::Crc8<Polynomial>::slices.value[0][data & 0xFF] ^
+               detail::Crc8<Polynomial>::slices.value[1][(data >> 8) & 0xFF] ^
+               detail::Crc8<Polynomial>::slices.value[2][index];
     }
 
-    LightLevel prev_value = LightLevel::Off;
+    // CRC пакета сегмента segment: та же CRC-8, но с начальным значением segment.
+    // Номер сегмента не передаётся явно, а подмешивается в контрольную сумму,
+    // поэтому сегмент 0 совпадает с обычными пакетами.
+    template <uint8_t Polynomial = kCrcPolynomial>
+    constexpr uint8_t crs8(uint16_t data, uint8_t index, uint8_t segment)
+    {
+        return crs8<Polynomial>(data, index) ^ detail::Crc8<Polynomial>::slices.value[0][segment];
+    }
 
-    static UnpackedPackage unpack_and_check(uint32_t packet)
+    template <uint8_t Polynomial = kCrcPolynomial>
+    inline UnpackedPackage unpack_and_check(uint32_t packet, uint8_t segment = 0)
     {
         // Извлекаем байты из packet
         // Структура: index (1 байт), word_low (1 байт), word_high (1 байт), crc (1 байт)
@@ -342,35 +568,2866 @@ namespace datapack
         uint16_t word = (static_cast<uint16_t>(word_high) << 8) | word_low;
 
         // Вычисляем ожидаемую контрольную сумму
-        uint8_t expected_crc = crs8(word, index);
+        uint8_t expected_crc = crs8<Polynomial>(word, index, segment);
 
         // Проверяем
         if (crc == expected_crc)
         {
-            return {true, index, word};
+            return {true, index, word, segment};
         }
         else
         {
-            return {false, 0, 0};
+            return {false, 0, 0, 0};
         }
     }
 
-    void feed(SignalChange sc)
+    // Кодирует один пакет (index, data low, data high, crc) в 16 символов out
+    template <uint8_t Polynomial = kCrcPolynomial>
+    inline LightLevel encodePacket(LightLevel prev, uint8_t index, uint16_t word, long symbolDuration, SignalChange *out,
+                                   uint8_t segment = 0) noexcept
     {
-        if (sc.duration < min_duration || sc.value == prev_value)
-            return;
+        const uint8_t bytes[4] = {index, static_cast<uint8_t>(word & 0xFF), static_cast<uint8_t>((word >> 8) & 0xFF), crs8<Polynomial>(word, index, segment)};
+        for (uint8_t byte : bytes)
+        {
+            prev = encodeByte(prev, byte, symbolDuration, out);
+            out += 4;
+        }
+        return prev;
+    }
+
+    constexpr std::size_t kMaxWords = 256;            // слов в сообщении (индекс - 1 байт)
+    constexpr std::size_t kSymbolsPerPacket = 16;     // 4 байта по 4 ди-бита
+    constexpr std::size_t kMaxSymbols = (kMaxWords + 1) * kSymbolsPerPacket; // + служебный пакет длины
 
-        uint8_t data = getDbit(prev_value, sc.value);
-        window <<= 2;
-        window |= data;
-        UnpackedPackage package = unpack_and_check(window);
-        if (package.valid)
+    using WordBuffer = StaticVector<uint16_t, kMaxWords>;
+    using SignalBuffer = StaticVector<SignalChange, kMaxSymbols>;
+
+    namespace detail
+    {
+        // Итератор по упакованному буферу: разворачивает элементы в SignalChange по требованию
+        template <typename Buffer>
+        class PackedIterator
         {
-            receive_buffer[package.index] = package.word;
-            if (onPacketReceived)
-                onPacketReceived(package);
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = SignalChange;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = SignalChange;
+
+            PackedIterator(const Buffer *buffer, std::size_t index) noexcept : buffer_(buffer), index_(index) {}
+
+            SignalChange operator*() const noexcept { return (*buffer_)[index_]; }
+
+            PackedIterator &operator++() noexcept
+            {
+                ++index_;
+                return *this;
+            }
+
+            PackedIterator operator++(int) noexcept
+            {
+                PackedIterator copy = *this;
+                ++index_;
+                return copy;
+            }
+
+            bool operator==(const PackedIterator &other) const noexcept { return index_ == other.index_; }
+
+            bool operator!=(const PackedIterator &other) const noexcept { return index_ != other.index_; }
+
+        private:
+            const Buffer *buffer_;
+            std::size_t index_;
+        };
+    }
+
+    namespace detail
+    {
+        // Длительность в тиках: до ближайшего, но не через порог глитчей. Переход не
+        // короче minDuration остаётся не короче (округление вверх), глитч - короче
+        // (вниз), поэтому после распаковки декодер отбрасывает те же переходы.
+        inline long quantizeTicks(long duration, long tick, long minDuration, long maxTicks) noexcept
+        {
+            if (duration <= 0)
+                return 0;
+            long ticks = (duration + tick / 2) / tick;
+            if (duration >= minDuration && ticks * tick < minDuration)
+                ticks = (duration + tick - 1) / tick;
+            else if (duration < minDuration && ticks * tick >= minDuration)
+                ticks = duration / tick;
+            return ticks > maxTicks ? maxTicks : ticks;
         }
+    }
+
+    // Компактный буфер символов: 2 байта на символ вместо 8-16 у SignalChange.
+    // Младшие 5 бит - уровень (хватает и на профиль Intensity4), старшие 11 -
+    // длительность в тиках по tick (до kMaxTicks). Округляется до ближайшего тика,
+    // но не через minDuration (см. detail::quantizeTicks). Отклонение тика меньше
+    // тика теряется, так что clock_recovery по распакованным символам видит
+    // номинальный тик; для его разбора нужны исходные длительности.
+    template <std::size_t Capacity>
+    class PackedSignalBuffer
+    {
+    public:
+        using const_iterator = detail::PackedIterator<PackedSignalBuffer>;
+
+        static constexpr uint16_t kMaxTicks = 0x07FF;
+
+        // minDuration - порог глитчей декодера, который будет читать буфер
+        explicit PackedSignalBuffer(long tick = 125, long minDuration = 60) noexcept
+            : tick_(tick > 0 ? tick : 1), min_duration_(minDuration), size_(0)
+        {
+        }
+
+        long tick() const noexcept { return tick_; }
+
+        long minDuration() const noexcept { return min_duration_; }
+
+        std::size_t size() const noexcept { return size_; }
+
+        constexpr std::size_t capacity() const noexcept { return Capacity; }
+
+        void clear() noexcept { size_ = 0; }
+
+        bool push_back(const SignalChange &sc) noexcept
+        {
+            if (size_ >= Capacity)
+            {
+                return false;
+            }
+            const long ticks = detail::quantizeTicks(sc.duration, tick_, min_duration_, kMaxTicks);
+            data_[size_++] = static_cast<uint16_t>((ticks << 5) | (static_cast<uint16_t>(sc.value) & 0x1F));
+            return true;
+        }
+
+        SignalChange operator[](std::size_t index) const noexcept
+        {
+            const uint16_t packed = data_[index];
+            return {static_cast<LightLevel>(packed & 0x1F), static_cast<long>(packed >> 5) * tick_};
+        }
+
+        // Разворачивает count символов начиная с first в out (например, для пакетного feed)
+        std::size_t copyTo(std::size_t first, std::size_t count, SignalChange *out) const noexcept
+        {
+            if (first >= size_)
+                return 0;
+            if (count > size_ - first)
+                count = size_ - first;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                out[i] = (*this)[first + i];
+            }
+            return count;
+        }
+
+        const uint16_t *data() const noexcept { return data_; }
+
+        const_iterator begin() const noexcept { return const_iterator(this, 0); }
+
+        const_iterator end() const noexcept { return const_iterator(this, size_); }
+
+    private:
+        long tick_;
+        long min_duration_;
+        uint16_t data_[Capacity];
+        std::size_t size_;
+    };
+
+    // Буфер только уровней - для передач, где все символы одной длительности
+    // (как у Encoder). Два символа на байт; push_back отвергает другие длительности
+    // и уровни выше 15 (последний уровень профиля Intensity4 - в PackedSignalBuffer).
+    template <std::size_t Capacity>
+    class LevelSignalBuffer
+    {
+    public:
+        using const_iterator = detail::PackedIterator<LevelSignalBuffer>;
+
+        explicit LevelSignalBuffer(long symbolDuration = 125) noexcept : duration_(symbolDuration), size_(0) {}
+
+        long duration() const noexcept { return duration_; }
+
+        std::size_t size() const noexcept { return size_; }
 
-        prev_value = sc.value;
+        constexpr std::size_t capacity() const noexcept { return Capacity; }
+
+        void clear() noexcept { size_ = 0; }
+
+        bool push_back(const SignalChange &sc) noexcept
+        {
+            if (size_ >= Capacity || sc.duration != duration_ || static_cast<unsigned>(sc.value) > 0x0F)
+            {
+                return false;
+            }
+            uint8_t &cell = data_[size_ / 2];
+            const uint8_t level = static_cast<uint8_t>(sc.value) & 0x0F;
+            cell = (size_ % 2 == 0) ? level : static_cast<uint8_t>((cell & 0x0F) | (level << 4));
+            ++size_;
+            return true;
+        }
+
+        SignalChange operator[](std::size_t index) const noexcept
+        {
+            const uint8_t cell = data_[index / 2];
+            const uint8_t level = (index % 2 == 0) ? (cell & 0x0F) : (cell >> 4);
+            return {static_cast<LightLevel>(level), duration_};
+        }
+
+        std::size_t copyTo(std::size_t first, std::size_t count, SignalChange *out) const noexcept
+        {
+            if (first >= size_)
+                return 0;
+            if (count > size_ - first)
+                count = size_ - first;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                out[i] = (*this)[first + i];
+            }
+            return count;
+        }
+
+        const_iterator begin() const noexcept { return const_iterator(this, 0); }
+
+        const_iterator end() const noexcept { return const_iterator(this, size_); }
+
+    private:
+        long duration_;
+        uint8_t data_[(Capacity + 1) / 2];
+        std::size_t size_;
+    };
+
+    // Алфавит символов. Classic - 5 уровней, 2 бита на переход. Intensity4 - у каждого
+    // цвета 4 ступени яркости (17 уровней), у перехода 16 вариантов - 4 бита.
+    // В Intensity4 длительность данных не несёт: run_length игнорируется.
+    enum class Modulation : uint8_t
+    {
+        Classic = 0,
+        Intensity4 = 1
+    };
+
+    struct ProtocolConfig
+    {
+        long min_duration = 60; // порог игнора
+        long duration = 125;    // продолжительность каждого сигнала
+        bool segmented = false; // декодер следит за номером сегмента (см. StreamEncoder)
+        bool frame_sync = false; // после захвата границ пакетов CRC проверяется только на них
+        bool run_length = false; // уровень держится 1-4 тика и несёт ещё 2 бита (см. encodeByteRunLength)
+        Modulation modulation = Modulation::Classic;
+        uint8_t fec_group = 0;   // слов данных в группе FEC (0 - без FEC), см. fecEncode
+        uint8_t fec_depth = 4;   // сколько групп FEC перемежаются
+        bool length_packet = false; // кодер дописывает служебный пакет с длиной сообщения
+                                    // (до max_words * 2 байт; см. setMessageCallback)
+        bool clock_recovery = false; // декодер подстраивает тик под фактический тик передатчика
+    };
+
+    // Параметры протокола, известные при компиляции; аргумент шаблонов BasicEncoder,
+    // BasicStreamEncoder и BasicDecoder. Свой протокол проще всего унаследовать
+    // отсюда и переопределить нужные поля:
+    //   max_words      - ёмкость сообщения и буфера приёма, слов (до 256: индекс - 1 байт)
+    //   crc_polynomial - полином CRC-8
+    //   fixed_config   - config зашит в код: setConfig не действует, а ветки
+    //                    неиспользуемых режимов и алфавитов исчезают при компиляции
+    //   statistics     - декодер ведёт счётчики DecoderStats; без него их код не компилируется
+    //   tracing        - декодер пишет трассу в TraceRing (setTrace); у протокола
+    //                    по умолчанию включается макросом DATAPACK_TRACE
+    //   config         - тайминги, алфавит и режимы (по умолчанию для конструкторов)
+    struct DefaultProtocol
+    {
+        static constexpr std::size_t max_words = kMaxWords;
+        static constexpr uint8_t crc_polynomial = kCrcPolynomial;
+        static constexpr bool fixed_config = false;
+        static constexpr bool statistics = false;
+        static constexpr bool tracing = DATAPACK_TRACE != 0;
+        static constexpr ProtocolConfig config{};
+    };
+
+    // Протокол по умолчанию со счётчиками декодера
+    struct InstrumentedProtocol : DefaultProtocol
+    {
+        static constexpr bool statistics = true;
+    };
+
+    constexpr std::size_t kRunLengthSymbolsPerPacket = 8; // 4 байта по 2 символа
+    constexpr long kMaxRunTicks = 4;
+
+    // Бит на переход: 2 (Classic), 4 (Classic + run_length или Intensity4)
+    constexpr unsigned symbolBits(const ProtocolConfig &config)
+    {
+        return (config.modulation == Modulation::Intensity4 || config.run_length) ? 4 : 2;
+    }
+
+    constexpr std::size_t symbolsPerPacket(const ProtocolConfig &config)
+    {
+        return symbolBits(config) == 4 ? kRunLengthSymbolsPerPacket : kSymbolsPerPacket;
+    }
+
+    // Уровни профиля Intensity4: 0 - Off, 1-4 - цвета на полной яркости (как в Classic),
+    // 5-16 - те же цвета на ступенях 1-3 (каждая следующая тусклее).
+    constexpr std::size_t kIntensitySteps = 4;
+    constexpr std::size_t kIntensityLevelCount = 1 + 4 * kIntensitySteps;
+
+    constexpr LightLevel makeLevel(LightLevel colour, uint8_t step)
+    {
+        return step == 0 ? colour : static_cast<LightLevel>(4 + (step - 1) * 4 + static_cast<int>(colour));
+    }
+
+    constexpr LightLevel baseColour(LightLevel level)
+    {
+        const int value = static_cast<int>(level);
+        return value <= 4 ? level : static_cast<LightLevel>((value - 5) % 4 + 1);
+    }
+
+    constexpr uint8_t intensityStep(LightLevel level)
+    {
+        const int value = static_cast<int>(level);
+        return value <= 4 ? 0 : static_cast<uint8_t>((value - 5) / 4 + 1);
+    }
+
+    namespace detail
+    {
+        // Из N уровней после prev возможны N - 1 других; символ - ранг следующего
+        // уровня среди них. Для Classic это ровно таблицы kDbitTable/kLightTable.
+        struct IntensityTables
+        {
+            uint8_t digit[kIntensityLevelCount][kIntensityLevelCount];
+            uint8_t level[kIntensityLevelCount][16];
+        };
+
+        constexpr IntensityTables makeIntensityTables()
+        {
+            IntensityTables tables{};
+            for (std::size_t p = 0; p < kIntensityLevelCount; ++p)
+            {
+                for (std::size_t c = 0; c < kIntensityLevelCount; ++c)
+                {
+                    tables.digit[p][c] = static_cast<uint8_t>(c == p ? 0 : (c < p ? c : c - 1));
+                }
+                for (std::size_t d = 0; d < 16; ++d)
+                {
+                    tables.level[p][d] = static_cast<uint8_t>(d < p ? d : d + 1);
+                }
+            }
+            return tables;
+        }
+
+        inline constexpr IntensityTables kIntensityTables = makeIntensityTables();
+    }
+
+    constexpr uint8_t getIntensityDigit(LightLevel prev, LightLevel curr)
+    {
+        const std::size_t p = static_cast<std::size_t>(prev);
+        const std::size_t c = static_cast<std::size_t>(curr);
+        if (p >= kIntensityLevelCount || c >= kIntensityLevelCount)
+            return 0;
+        return detail::kIntensityTables.digit[p][c];
+    }
+
+    constexpr LightLevel getLightForIntensityDigit(LightLevel prev, uint8_t digit)
+    {
+        std::size_t p = static_cast<std::size_t>(prev);
+        if (p >= kIntensityLevelCount)
+            p = 0;
+        return static_cast<LightLevel>(detail::kIntensityTables.level[p][digit & 0x0F]);
+    }
+
+    // Профиль Intensity4: байт - два перехода, по полубайту на каждый
+    inline LightLevel encodeByteIntensity(LightLevel prev, uint8_t byte, long symbolDuration, SignalChange *out) noexcept
+    {
+        prev = getLightForIntensityDigit(prev, byte >> 4);
+        out[0] = {prev, symbolDuration};
+        prev = getLightForIntensityDigit(prev, byte & 0x0F);
+        out[1] = {prev, symbolDuration};
+        return prev;
+    }
+
+    // Режим run_length: байт - два перехода по полубайту. Старшие 2 бита полубайта
+    // выбирают цвет, как обычный ди-бит, младшие - сколько тиков (1-4) держать уровень.
+    // Переходов на байт вдвое меньше, эфирное время в среднем 5 тиков вместо 4.
+    inline LightLevel encodeByteRunLength(LightLevel prev, uint8_t byte, long symbolDuration, SignalChange *out) noexcept
+    {
+        const uint8_t nibbles[2] = {static_cast<uint8_t>(byte >> 4), static_cast<uint8_t>(byte & 0x0F)};
+        for (uint8_t nibble : nibbles)
+        {
+            prev = getLightForDbit(prev, nibble >> 2);
+            *out++ = {prev, symbolDuration * ((nibble & 0x03) + 1)};
+        }
+        return prev;
+    }
+
+    // Кодирует пакет в symbolsPerPacket(config) символов out
+    template <uint8_t Polynomial = kCrcPolynomial>
+    inline LightLevel encodePacket(LightLevel prev, uint8_t index, uint16_t word, const ProtocolConfig &config,
+                                   SignalChange *out, uint8_t segment = 0) noexcept
+    {
+        const bool intensity = config.modulation == Modulation::Intensity4;
+        if (!intensity && !config.run_length)
+            return encodePacket<Polynomial>(prev, index, word, config.duration, out, segment);
+        const uint8_t bytes[4] = {index, static_cast<uint8_t>(word & 0xFF), static_cast<uint8_t>((word >> 8) & 0xFF), crs8<Polynomial>(word, index, segment)};
+        for (uint8_t byte : bytes)
+        {
+            prev = intensity ? encodeByteIntensity(prev, byte, config.duration, out)
+                             : encodeByteRunLength(prev, byte, config.duration, out);
+            out += 2;
+        }
+        return prev;
+    }
+
+    // Служебные пакеты отличаются от пакетов данных только CRC: она считается как для
+    // сегмента segment ^ kMetaSegmentFlag. Декодер в режиме segmented проверяет лишь
+    // текущий и следующий сегменты, так что с данными они не пересекаются.
+    constexpr uint8_t kMetaSegmentFlag = 0x80;
+
+    // Типы служебных пакетов (поле index)
+    constexpr uint8_t kMetaLength = 0; // word - длина сообщения в байтах
+
+    template <uint8_t Polynomial = kCrcPolynomial>
+    inline LightLevel encodeMetaPacket(LightLevel prev, uint8_t type, uint16_t value, const ProtocolConfig &config,
+                                       SignalChange *out, uint8_t segment = 0) noexcept
+    {
+        return encodePacket<Polynomial>(prev, type, value, config, out, static_cast<uint8_t>(segment ^ kMetaSegmentFlag));
+    }
+
+    // Число тиков (1-4) в принятом символе режима run_length
+    constexpr uint8_t quantizeRun(long duration, long tick)
+    {
+        const long ticks = (duration + tick / 2) / tick;
+        return static_cast<uint8_t>(ticks < 1 ? 1 : (ticks > kMaxRunTicks ? kMaxRunTicks : ticks));
+    }
+
+    // Собирает байты в слова little-endian; нечётный хвост дополняется нулём
+    template <typename Words>
+    inline void packWords(const uint8_t *data, std::size_t len, Words &words) noexcept
+    {
+        words.clear();
+        for (std::size_t i = 0; i < len; i += 2)
+        {
+            uint16_t word = data[i];
+            if (i + 1 < len)
+            {
+                word |= (static_cast<uint16_t>(data[i + 1]) << 8);
+            }
+            if (!words.push_back(word))
+                return;
+        }
+    }
+
+    /*
+        FEC по группам пакетов. Пакет с плохой CRC просто теряется, поэтому ошибки
+        на уровне слов - стирания с известной позицией. Каждые group слов данных
+        дополняются двумя словами чётности, как в RAID-6 (код Рида-Соломона с двумя
+        проверочными символами над GF(256), отдельно для каждого байта слова):
+            P = d0 ^ d1 ^ ... ^ d(k-1)
+            Q = g^0·d0 ^ g^1·d1 ^ ... ^ g^(k-1)·d(k-1)
+        Любые два потерянных слова группы восстанавливаются.
+
+        Сбой символа обычно выбивает несколько пакетов подряд, поэтому depth групп
+        перемежаются в блок из depth * (group + 2) слов: сначала depth * group слов
+        данных в исходном порядке (слово r блока относится к группе r % depth), затем
+        P всех групп, затем Q. Так восстанавливается пачка до 2 * depth потерянных
+        пакетов подряд. Последний блок дополняется нулевыми словами. Приёмнику
+        достаточно знать group и depth, длина сообщения не нужна.
+    */
+
+    namespace detail
+    {
+        // GF(256) с полиномом 0x11D и образующим 2
+        struct GfTables
+        {
+            uint8_t exp[512];
+            uint8_t log[256];
+        };
+
+        constexpr GfTables makeGfTables()
+        {
+            GfTables tables{};
+            unsigned x = 1;
+            for (std::size_t i = 0; i < 255; ++i)
+            {
+                tables.exp[i] = static_cast<uint8_t>(x);
+                tables.log[x] = static_cast<uint8_t>(i);
+                x <<= 1;
+                if (x & 0x100)
+                    x ^= 0x11D;
+            }
+            for (std::size_t i = 255; i < 512; ++i)
+            {
+                tables.exp[i] = tables.exp[i - 255];
+            }
+            return tables;
+        }
+
+        inline constexpr GfTables kGfTables = makeGfTables();
+
+        constexpr uint8_t gfMul(uint8_t a, uint8_t b)
+        {
+            return (a == 0 || b == 0) ? 0 : kGfTables.exp[kGfTables.log[a] + kGfTables.log[b]];
+        }
+
+        constexpr uint8_t gfDiv(uint8_t a, uint8_t b)
+        {
+            return a == 0 ? 0 : kGfTables.exp[kGfTables.log[a] + 255 - kGfTables.log[b]];
+        }
+
+        // g^power * word, побайтно
+        constexpr uint16_t gfScaleWord(uint16_t word, std::size_t power)
+        {
+            const uint8_t factor = kGfTables.exp[power % 255];
+            return static_cast<uint16_t>(gfMul(static_cast<uint8_t>(word & 0xFF), factor) |
+                                         (gfMul(static_cast<uint8_t>(word >> 8), factor) << 8));
+        }
+
+        constexpr uint16_t gfDivWord(uint16_t word, uint8_t divisor)
+        {
+            return static_cast<uint16_t>(gfDiv(static_cast<uint8_t>(word & 0xFF), divisor) |
+                                         (gfDiv(static_cast<uint8_t>(word >> 8), divisor) << 8));
+        }
+    }
+
+    constexpr std::size_t fecBlockWords(std::size_t group, std::size_t depth) { return depth * (group + 2); }
+
+    constexpr bool fecValid(std::size_t group, std::size_t depth, std::size_t words = kMaxWords)
+    {
+        return group > 0 && depth > 0 && group <= 253 && fecBlockWords(group, depth) <= words;
+    }
+
+    // Сколько слов данных помещается в сообщение из words пакетов
+    constexpr std::size_t fecDataCapacity(std::size_t group, std::size_t depth, std::size_t words = kMaxWords)
+    {
+        return group == 0 ? words
+                          : (fecValid(group, depth, words) ? (words / fecBlockWords(group, depth)) * depth * group : 0);
+    }
+
+    // Сколько слов уходит в эфир для dataWords слов данных
+    constexpr std::size_t fecEncodedWords(std::size_t dataWords, std::size_t group, std::size_t depth)
+    {
+        return group == 0 ? dataWords
+                          : (dataWords + depth * group - 1) / (depth * group) * fecBlockWords(group, depth);
+    }
+
+    // Добавляет к count словам данных слова чётности; false, если не помещается
+    template <typename Words>
+    inline bool fecEncode(const uint16_t *data, std::size_t count, std::size_t group, std::size_t depth,
+                          Words &out) noexcept
+    {
+        out.clear();
+        if (!fecValid(group, depth, out.capacity()) || count > fecDataCapacity(group, depth, out.capacity()))
+            return false;
+        const std::size_t blockData = depth * group;
+        for (std::size_t first = 0; first < count; first += blockData)
+        {
+            uint16_t p[kMaxWords / 2] = {};
+            uint16_t q[kMaxWords / 2] = {};
+            for (std::size_t r = 0; r < blockData; ++r)
+            {
+                const uint16_t word = first + r < count ? data[first + r] : 0;
+                out.push_back(word);
+                p[r % depth] ^= word;
+                q[r % depth] ^= detail::gfScaleWord(word, r / depth);
+            }
+            out.append(p, depth);
+            out.append(q, depth);
+        }
+        return true;
+    }
+
+    // Восстанавливает данные из принятых слов. received(i) сообщает, принято ли
+    // слово i. Записывает blocks * depth * group слов в data, возвращает число
+    // слов данных, которые восстановить не удалось.
+    template <typename Received>
+    inline std::size_t fecDecode(const uint16_t *words, Received &&received, std::size_t blocks, std::size_t group,
+                                 std::size_t depth, uint16_t *data) noexcept
+    {
+        std::size_t lost = 0;
+        for (std::size_t b = 0; b < blocks; ++b)
+        {
+            const std::size_t base = b * fecBlockWords(group, depth);
+            uint16_t *out = data + b * depth * group;
+            for (std::size_t g = 0; g < depth; ++g)
+            {
+                const std::size_t pIndex = base + depth * group + g;
+                const std::size_t qIndex = pIndex + depth;
+                const bool hasP = received(pIndex);
+                const bool hasQ = received(qIndex);
+                uint16_t p = hasP ? words[pIndex] : 0;
+                uint16_t q = hasQ ? words[qIndex] : 0;
+                std::size_t missing[2] = {0, 0};
+                std::size_t missingCount = 0;
+
+                for (std::size_t i = 0; i < group; ++i)
+                {
+                    const std::size_t r = i * depth + g;
+                    if (received(base + r))
+                    {
+                        out[r] = words[base + r];
+                        p ^= out[r];
+                        q ^= detail::gfScaleWord(out[r], i);
+                    }
+                    else
+                    {
+                        out[r] = 0;
+                        if (missingCount < 2)
+                            missing[missingCount] = i;
+                        ++missingCount;
+                    }
+                }
+
+                if (missingCount == 0)
+                    continue;
+                if (missingCount == 1 && hasP)
+                {
+                    out[missing[0] * depth + g] = p;
+                }
+                else if (missingCount == 1 && hasQ)
+                {
+                    out[missing[0] * depth + g] = detail::gfDivWord(q, detail::kGfTables.exp[missing[0]]);
+                }
+                else if (missingCount == 2 && hasP && hasQ)
+                {
+                    // p = dx ^ dy, q = g^x·dx ^ g^y·dy  =>  dx = (g^y·p ^ q) / (g^x ^ g^y)
+                    const std::size_t x = missing[0];
+                    const std::size_t y = missing[1];
+                    const uint8_t divisor = detail::kGfTables.exp[x] ^ detail::kGfTables.exp[y];
+                    const uint16_t dx = detail::gfDivWord(static_cast<uint16_t>(detail::gfScaleWord(p, y) ^ q), divisor);
+                    out[x * depth + g] = dx;
+                    out[y * depth + g] = p ^ dx;
+                }
+                else
+                {
+                    lost += missingCount;
+                }
+            }
+        }
+        return lost;
+    }
+
+    namespace detail
+    {
+        // Приёмник символов: либо вызываемый объект sink(const SignalChange &),
+        // либо выходной итератор.
+        template <typename Sink>
+        inline void emit(Sink &sink, const SignalChange &sc)
+        {
+            if constexpr (std::is_invocable_v<Sink &, const SignalChange &>)
+            {
+                sink(sc);
+            }
+            else
+            {
+                *sink = sc;
+                ++sink;
+            }
+        }
+    }
+
+    // События трассировки
+    enum class TraceEvent : uint8_t
+    {
+        Symbol = 0,      // переход вошёл в окно; crc - итог проверки окна
+        Filtered = 1,    // переход отброшен как глитч или повтор уровня
+        Packet = 2,      // пакет выдан приложению (перед коллбэком)
+        EncodeBegin = 3, // начало кодирования, duration - длина данных в байтах
+        EncodeEnd = 4    // конец кодирования, duration - число символов
+    };
+
+    // Итог проверки окна в записи Symbol
+    enum class TraceCrc : uint8_t
+    {
+        Skipped = 0, // окно не проверялось (захват frame_sync вне границы пакета)
+        Fail = 1,
+        Pass = 2,
+        Meta = 3 // служебный пакет length_packet
+    };
+
+    // Запись трассы: 16 байт без указателей, копируется в дамп как есть.
+    // window - окно декодера после перехода; у Packet - segment << 24 | index << 16 | word.
+    struct TraceRecord
+    {
+        uint32_t timestamp;
+        int32_t duration;
+        uint32_t window;
+        uint8_t event; // TraceEvent
+        uint8_t level; // LightLevel
+        uint8_t crc;   // TraceCrc
+        uint8_t reserved;
+    };
+    static_assert(sizeof(TraceRecord) == 16, "формат дампа трассы");
+
+    // Часы трассы: микросекунды, такты DWT->CYCCNT и т.п. Переполнение допустимо -
+    // при разборе важны разности соседних отметок.
+    using TraceClock = uint32_t (*)();
+
+    constexpr std::size_t kTraceCapacity = 256;
+    constexpr std::size_t kTraceRecordSize = sizeof(TraceRecord);
+
+    // Последние kTraceCapacity событий; старые вытесняются, памяти не выделяет
+    using TraceRing = RingBuffer<TraceRecord, kTraceCapacity>;
+
+    // Сохраняет трассу (от старых событий к новым) в out - не меньше
+    // kTraceCapacity * kTraceRecordSize байт - в little-endian независимо от
+    // платформы. Возвращает число записанных байтов; разбор - parseTrace в datapacklib_host.h.
+    inline std::size_t dumpTrace(const TraceRing &ring, uint8_t *out) noexcept
+    {
+        for (std::size_t i = 0; i < ring.size(); ++i)
+        {
+            const TraceRecord &record = ring[i];
+            const uint32_t fields[3] = {record.timestamp, static_cast<uint32_t>(record.duration), record.window};
+            for (uint32_t field : fields)
+            {
+                for (unsigned k = 0; k < 4; ++k)
+                    *out++ = static_cast<uint8_t>(field >> (8 * k));
+            }
+            *out++ = record.event;
+            *out++ = record.level;
+            *out++ = record.crc;
+            *out++ = record.reserved;
+        }
+        return ring.size() * kTraceRecordSize;
+    }
+
+    namespace detail
+    {
+        inline void trace(TraceRing *ring, TraceClock clock, TraceEvent event, long duration, uint32_t window,
+                          TraceCrc crc = TraceCrc::Skipped) noexcept
+        {
+            if (ring)
+                ring->push_back({clock ? clock() : 0u, static_cast<int32_t>(duration), window,
+                                 static_cast<uint8_t>(event), 0, static_cast<uint8_t>(crc), 0});
+        }
+    }
+
+    // Кодер не хранит ничего, кроме настроек: его можно создавать на каждый вызов
+    // и использовать из нескольких потоков одновременно (без трассы).
+    template <typename Protocol = DefaultProtocol>
+    class BasicEncoder
+    {
+    public:
+        static constexpr std::size_t kMaxWords = Protocol::max_words;
+        static constexpr uint8_t kPolynomial = Protocol::crc_polynomial;
+        static_assert(kMaxWords > 0 && kMaxWords <= 256, "индекс пакета - один байт");
+
+        using Words = StaticVector<uint16_t, kMaxWords>;
+        using Signals = StaticVector<SignalChange, (kMaxWords + 1) * kSymbolsPerPacket>;
+
+        explicit BasicEncoder(const ProtocolConfig &config = Protocol::config) noexcept
+            : config_(config), trace_(nullptr), trace_clock_(nullptr)
+        {
+        }
+
+        // Действующие настройки: при fixed_config - константы протокола
+        const ProtocolConfig &config() const noexcept
+        {
+            if constexpr (Protocol::fixed_config)
+                return Protocol::config;
+            else
+                return config_;
+        }
+
+        void setConfig(const ProtocolConfig &config) noexcept { config_ = config; }
+
+        // Записывать начало и конец encode/encodeTo в ring; nullptr отключает трассу
+        void setTrace(TraceRing *ring, TraceClock clock) noexcept
+        {
+            trace_ = ring;
+            trace_clock_ = clock;
+        }
+
+        // Кодирует слова; каждому слову соответствует пакет с индексом, равным его позиции
+        bool encodeWords(const uint16_t *words, std::size_t count, Signals &out) const noexcept
+        {
+            out.clear();
+            if (count > kMaxWords)
+                return false;
+            LightLevel prevValue = LightLevel::Off;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                SignalChange symbols[kSymbolsPerPacket];
+                prevValue = encodePacket<kPolynomial>(prevValue, static_cast<uint8_t>(i), words[i], config(), symbols);
+                out.append(symbols, symbolsPerPacket(config()));
+            }
+            return true;
+        }
+
+        // Обновляет out - результат encodeWords(words, count) - после того, как в words
+        // изменились слова [first, first + changed). Перекодируются изменённые пакеты и
+        // следующие за ними, пока последний уровень пакета не совпадёт со старым: дальше
+        // цепочка уровней та же, что была. Если out не от такого вызова (другой размер),
+        // сообщение кодируется заново.
+        bool updateWords(const uint16_t *words, std::size_t count, std::size_t first, std::size_t changed,
+                         Signals &out) const noexcept
+        {
+            if (count > kMaxWords || out.size() != count * symbolsPerPacket(config()))
+                return encodeWords(words, count, out);
+            rechain(count, first, changed, [words](std::size_t i) { return words[i]; }, out);
+            return true;
+        }
+
+        // То же для encode: в data (len байт) изменились байты [first, first + changed);
+        // у укороченного на байт сообщения это отброшенный байт len. С length_packet
+        // служебный пакет перекодируется всегда: он один, а len могла измениться и без
+        // смены числа пакетов (39 -> 40 байт). С FEC чётность зависит от целых групп -
+        // тогда сообщение кодируется заново.
+        bool update(const uint8_t *data, std::size_t len, std::size_t first, std::size_t changed,
+                    Signals &out) const noexcept
+        {
+            const std::size_t count = (len + 1) / 2;
+            const std::size_t packetSymbols = symbolsPerPacket(config());
+            const std::size_t packets = count + (config().length_packet ? 1 : 0);
+            if (config().fec_group != 0 || count > kMaxWords || out.size() != packets * packetSymbols)
+                return encode(data, len, out);
+            // правка за концом данных (укороченное сообщение) трогает только дополнение
+            // нечётного хвоста нулём - последнее слово
+            const std::size_t firstWord = first / 2;
+            if (changed != 0 && firstWord < count)
+            {
+                if (changed > 2 * count - first)
+                    changed = 2 * count - first;
+                const auto wordAt = [data, len](std::size_t i) {
+                    uint16_t word = data[2 * i];
+                    if (2 * i + 1 < len)
+                        word |= static_cast<uint16_t>(data[2 * i + 1]) << 8;
+                    return word;
+                };
+                rechain(count, firstWord, (first + changed + 1) / 2 - firstWord, wordAt, out);
+            }
+            if (config().length_packet)
+            {
+                const LightLevel prev = count == 0 ? LightLevel::Off : out[count * packetSymbols - 1].value;
+                encodeMetaPacket<kPolynomial>(prev, kMetaLength, static_cast<uint16_t>(len), config(),
+                                              out.data() + count * packetSymbols);
+            }
+            return true;
+        }
+
+        // Слова, которые encode передаёт в эфир: данные и, с fec_group, чётность.
+        // Слово с индексом i - пакет i; для encodeSelected и Carousel.
+        bool messageWords(const uint8_t *data, std::size_t len, Words &words) const noexcept
+        {
+            words.clear();
+            if (len > fecDataCapacity(config().fec_group, config().fec_depth, kMaxWords) * 2)
+                return false;
+            packWords(data, len, words);
+            if (config().fec_group != 0)
+            {
+                Words protectedWords;
+                if (!fecEncode(words.data(), words.size(), config().fec_group, config().fec_depth, protectedWords))
+                    return false;
+                words = protectedWords;
+            }
+            return true;
+        }
+
+        // Кодирует только пакеты с индексами indices (в их порядке) из сообщения words
+        // на count слов; индексы за его пределами пропускаются. prev - уровень, на
+        // котором остановилась предыдущая передача. Возвращает число пакетов.
+        std::size_t encodeSelected(const uint16_t *words, std::size_t count, const uint8_t *indices, std::size_t n,
+                                   Signals &out, LightLevel prev = LightLevel::Off) const noexcept
+        {
+            out.clear();
+            std::size_t packets = 0;
+            for (std::size_t k = 0; k < n && out.size() + symbolsPerPacket(config()) <= out.capacity(); ++k)
+            {
+                if (indices[k] >= count)
+                    continue;
+                SignalChange symbols[kSymbolsPerPacket];
+                prev = encodePacket<kPolynomial>(prev, indices[k], words[indices[k]], config(), symbols);
+                out.append(symbols, symbolsPerPacket(config()));
+                ++packets;
+            }
+            return packets;
+        }
+
+        // Повтор по карте приёма (BasicDecoder::receivedBitmap): только пакеты, которых нет в received
+        std::size_t encodeMissing(const uint16_t *words, std::size_t count, const uint32_t *received, Signals &out,
+                                  LightLevel prev = LightLevel::Off) const noexcept
+        {
+            out.clear();
+            std::size_t packets = 0;
+            for (std::size_t i = 0; i < count && i < kMaxWords; ++i)
+            {
+                if ((received[i / 32] >> (i % 32)) & 1u)
+                    continue;
+                SignalChange symbols[kSymbolsPerPacket];
+                prev = encodePacket<kPolynomial>(prev, static_cast<uint8_t>(i), words[i], config(), symbols);
+                out.append(symbols, symbolsPerPacket(config()));
+                ++packets;
+            }
+            return packets;
+        }
+
+        // Кодирует произвольный массив байтов; false, если он не помещается в сообщение.
+        // С fec_group к данным добавляются слова чётности (ёмкость - fecDataCapacity).
+        bool encode(const uint8_t *data, std::size_t len, Signals &out) const noexcept
+        {
+            detail::trace(trace_, trace_clock_, TraceEvent::EncodeBegin, static_cast<long>(len), 0);
+            const bool done = encodeSignals(data, len, out);
+            detail::trace(trace_, trace_clock_, TraceEvent::EncodeEnd, static_cast<long>(out.size()), 0);
+            return done;
+        }
+
+        // Кодирует байты сразу в sink (лямбда, пишущая в регистры ШИМ, кольцевой буфер,
+        // выходной итератор), без промежуточных буферов символов. Без FEC длина не
+        // ограничена: после 256 пакетов нумерация продолжается сегментами, как в
+        // StreamEncoder. С fec_group чётность считается по всему сообщению, и оно, как
+        // в encode, должно поместиться в fecDataCapacity слов; с length_packet - в
+        // kMaxWords слов: более длинное декодер не соберёт и служебный пакет отбросит.
+        // Итератор, переданный как lvalue, продвигается на месте. false - сообщение не
+        // подходит, в sink ничего не выдано. В last (если задан) - последний выданный
+        // уровень.
+        template <typename Sink>
+        bool encodeTo(const uint8_t *data, std::size_t len, Sink &&sink, LightLevel *last = nullptr) const
+        {
+            const bool fec = config().fec_group != 0;
+            if ((fec && len > fecDataCapacity(config().fec_group, config().fec_depth, kMaxWords) * 2) ||
+                (config().length_packet && len > kMaxWords * 2))
+                return false;
+            detail::trace(trace_, trace_clock_, TraceEvent::EncodeBegin, static_cast<long>(len), 0);
+            const std::size_t count = symbolsPerPacket(config());
+            LightLevel prevValue = LightLevel::Off;
+            uint32_t packet = 0;
+            const auto emitPacket = [&](uint16_t word) {
+                SignalChange symbols[kSymbolsPerPacket];
+                prevValue = encodePacket<kPolynomial>(prevValue, static_cast<uint8_t>(packet & 0xFF), word, config(),
+                                                      symbols, static_cast<uint8_t>((packet >> 8) & 0xFF));
+                for (std::size_t k = 0; k < count; ++k)
+                    detail::emit(sink, symbols[k]);
+                ++packet;
+            };
+            if (fec)
+            {
+                // слова данных и чётности - те же, что у encode
+                Words words;
+                if (!messageWords(data, len, words))
+                    return false;
+                for (std::size_t i = 0; i < words.size(); ++i)
+                    emitPacket(words[i]);
+            }
+            else
+            {
+                for (std::size_t i = 0; i < len; i += 2)
+                    emitPacket(static_cast<uint16_t>(data[i] | (i + 1 < len ? data[i + 1] << 8 : 0)));
+            }
+            uint32_t symbols = packet * static_cast<uint32_t>(count);
+            if (config().length_packet)
+            {
+                SignalChange meta[kSymbolsPerPacket];
+                const uint8_t segment = static_cast<uint8_t>(((packet == 0 ? 0 : packet - 1) >> 8) & 0xFF);
+                prevValue = encodeMetaPacket<kPolynomial>(prevValue, kMetaLength, static_cast<uint16_t>(len), config(),
+                                                          meta, segment);
+                for (std::size_t k = 0; k < count; ++k)
+                    detail::emit(sink, meta[k]);
+                symbols += static_cast<uint32_t>(count);
+            }
+            detail::trace(trace_, trace_clock_, TraceEvent::EncodeEnd, static_cast<long>(symbols), 0);
+            if (last)
+                *last = prevValue;
+            return true;
+        }
+
+    private:
+        // Перекодирует пакеты данных с first и дальше, пока цепочка уровней не сойдётся
+        // со старой
+        template <typename WordAt>
+        void rechain(std::size_t count, std::size_t first, std::size_t changed, WordAt wordAt,
+                     Signals &out) const noexcept
+        {
+            if (first >= count || changed == 0)
+                return;
+            const std::size_t packetSymbols = symbolsPerPacket(config());
+            const std::size_t end = changed > count - first ? count : first + changed;
+            LightLevel prev = first == 0 ? LightLevel::Off : out[first * packetSymbols - 1].value;
+            for (std::size_t i = first; i < count; ++i)
+            {
+                const LightLevel oldLast = out[(i + 1) * packetSymbols - 1].value;
+                prev = encodePacket<kPolynomial>(prev, static_cast<uint8_t>(i), wordAt(i), config(),
+                                                 out.data() + i * packetSymbols);
+                if (i + 1 >= end && prev == oldLast)
+                    return;
+            }
+        }
+
+        bool encodeSignals(const uint8_t *data, std::size_t len, Signals &out) const noexcept
+        {
+            out.clear();
+            Words words;
+            if (!messageWords(data, len, words) || !encodeWords(words.data(), words.size(), out))
+                return false;
+            if (config().length_packet)
+            {
+                SignalChange symbols[kSymbolsPerPacket];
+                const LightLevel prev = out.size() > 0 ? out[out.size() - 1].value : LightLevel::Off;
+                encodeMetaPacket<kPolynomial>(prev, kMetaLength, static_cast<uint16_t>(len), config(), symbols);
+                out.append(symbols, symbolsPerPacket(config()));
+            }
+            return true;
+        }
+
+        ProtocolConfig config_;
+        TraceRing *trace_;
+        TraceClock trace_clock_;
+    };
+
+    using Encoder = BasicEncoder<>;
+
+    // Источник данных для StreamEncoder: пишет до max байтов в dst, возвращает
+    // сколько записал; 0 - данные закончились.
+    using ByteSource = std::size_t (*)(uint8_t *dst, std::size_t max, void *context);
+
+    // Потоковый кодер сообщений произвольной длины. Символы выдаются порциями по
+    // запросу, целиком сообщение нигде не хранится: в памяти только текущий пакет.
+    // Пакеты нумеруются сквозным счётчиком: младший байт - index, старший -
+    // номер сегмента, который подмешивается в CRC (см. crs8 с segment). Первые
+    // 256 пакетов совпадают с выводом Encoder; декодеру нужен режим segmented.
+    template <typename Protocol = DefaultProtocol>
+    class BasicStreamEncoder
+    {
+    public:
+        static constexpr std::size_t kChunkSize = 32; // буфер чтения из ByteSource
+        static constexpr uint8_t kPolynomial = Protocol::crc_polynomial;
+
+        // До первого start кодер молчит: next ничего не выдаёт, даже служебный пакет длины
+        explicit BasicStreamEncoder(const ProtocolConfig &config = Protocol::config) noexcept : config_(config)
+        {
+            start(static_cast<const uint8_t *>(nullptr), 0);
+            finished_ = true;
+            length_sent_ = true;
+        }
+
+        // Действующие настройки: при fixed_config - константы протокола
+        const ProtocolConfig &config() const noexcept
+        {
+            if constexpr (Protocol::fixed_config)
+                return Protocol::config;
+            else
+                return config_;
+        }
+
+        // Кодировать данные из буфера вызывающего (буфер должен жить до конца передачи).
+        // prev - уровень, на котором стоит излучатель: с last() предыдущего сообщения
+        // цепочка уровней продолжается без паузы, как у одного длинного потока.
+        void start(const uint8_t *data, std::size_t len, LightLevel prev = LightLevel::Off) noexcept
+        {
+            reset(prev);
+            data_ = data;
+            len_ = len;
+            source_ = nullptr;
+            source_context_ = nullptr;
+        }
+
+        // Кодировать данные, которые по мере надобности отдаёт source
+        void start(ByteSource source, void *context, LightLevel prev = LightLevel::Off) noexcept
+        {
+            reset(prev);
+            data_ = chunk_;
+            len_ = 0;
+            source_ = source;
+            source_context_ = context;
+        }
+
+        // Пишет до maxSymbols следующих символов в out; 0 - сообщение закончилось
+        std::size_t next(SignalChange *out, std::size_t maxSymbols) noexcept
+        {
+            std::size_t written = 0;
+            while (written < maxSymbols)
+            {
+                if (pending_pos_ == pending_count_ && !loadPacket())
+                    break;
+                std::size_t count = pending_count_ - pending_pos_;
+                if (count > maxSymbols - written)
+                    count = maxSymbols - written;
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    out[written + i] = pending_[pending_pos_ + i];
+                }
+                pending_pos_ += count;
+                written += count;
+            }
+            return written;
+        }
+
+        bool done() const noexcept { return finished_ && pending_pos_ == pending_count_; }
+
+        // Сколько пакетов уже сформировано (включая текущий)
+        uint32_t packets() const noexcept { return packet_; }
+
+        // Уровень последнего сформированного символа (после done - конец сообщения)
+        LightLevel last() const noexcept { return prev_; }
+
+    private:
+        void reset(LightLevel prev) noexcept
+        {
+            pos_ = 0;
+            packet_ = 0;
+            prev_ = prev;
+            pending_pos_ = 0;
+            pending_count_ = 0;
+            finished_ = false;
+            length_sent_ = false;
+        }
+
+        bool nextByte(uint8_t &byte) noexcept
+        {
+            if (pos_ == len_)
+            {
+                if (!source_)
+                    return false;
+                len_ = source_(chunk_, kChunkSize, source_context_);
+                pos_ = 0;
+                if (len_ == 0)
+                {
+                    source_ = nullptr;
+                    return false;
+                }
+            }
+            byte = data_[pos_++];
+            return true;
+        }
+
+        bool loadPacket() noexcept
+        {
+            uint8_t low = 0;
+            uint8_t high = 0;
+            if (finished_ || !nextByte(low))
+            {
+                // длину знаем только у буфера; коллбэк-источник её не сообщает. Сообщение
+                // длиннее max_words слов декодер не соберёт - пакет длины не нужен.
+                if (!length_sent_ && config().length_packet && !source_ && data_ != chunk_ &&
+                    len_ <= Protocol::max_words * 2)
+                {
+                    length_sent_ = true;
+                    finished_ = true;
+                    const uint8_t segment = static_cast<uint8_t>(((packet_ == 0 ? 0 : packet_ - 1) >> 8) & 0xFF);
+                    prev_ = encodeMetaPacket<kPolynomial>(prev_, kMetaLength, static_cast<uint16_t>(len_), config(),
+                                                          pending_, segment);
+                    pending_pos_ = 0;
+                    pending_count_ = symbolsPerPacket(config());
+                    return true;
+                }
+                finished_ = true;
+                return false;
+            }
+            // нечётный хвост дополняется нулём, как в packWords
+            if (!nextByte(high))
+                finished_ = true;
+
+            const uint16_t word = static_cast<uint16_t>(low | (high << 8));
+            prev_ = encodePacket<kPolynomial>(prev_, static_cast<uint8_t>(packet_ & 0xFF), word, config(), pending_,
+                                              static_cast<uint8_t>((packet_ >> 8) & 0xFF));
+            ++packet_;
+            pending_pos_ = 0;
+            pending_count_ = symbolsPerPacket(config());
+            return true;
+        }
+
+        ProtocolConfig config_;
+        const uint8_t *data_;
+        std::size_t len_;
+        std::size_t pos_;
+        ByteSource source_;
+        void *source_context_;
+        uint32_t packet_;
+        LightLevel prev_;
+        bool finished_;
+        bool length_sent_;
+        std::size_t pending_pos_;
+        std::size_t pending_count_;
+        SignalChange pending_[kSymbolsPerPacket];
+        uint8_t chunk_[kChunkSize];
+    };
+
+    using StreamEncoder = BasicStreamEncoder<>;
+
+    // Карусель для односторонних и медленных каналов: сообщение передаётся по кругу,
+    // а пакеты, о потере которых сообщил приёмник, вставляются вне очереди - до
+    // priorityShare() приоритетных на один фоновый, так что круг не останавливается.
+    // Слова не копируются: words должны жить, пока идёт передача. Интерфейс выдачи
+    // как у StreamEncoder, но символы не заканчиваются.
+    template <typename Protocol = DefaultProtocol>
+    class BasicCarousel
+    {
+    public:
+        static constexpr std::size_t kMaxWords = Protocol::max_words;
+        static constexpr uint8_t kPolynomial = Protocol::crc_polynomial;
+        static_assert(kMaxWords > 0 && kMaxWords <= 256, "индекс пакета - один байт");
+
+        explicit BasicCarousel(const ProtocolConfig &config = Protocol::config) noexcept
+            : config_(config), priority_share_(3)
+        {
+            start(nullptr, 0);
+        }
+
+        // Действующие настройки: при fixed_config - константы протокола
+        const ProtocolConfig &config() const noexcept
+        {
+            if constexpr (Protocol::fixed_config)
+                return Protocol::config;
+            else
+                return config_;
+        }
+
+        // words - слова в эфире (BasicEncoder::messageWords); length - длина сообщения
+        // в байтах для служебного пакета, который с length_packet замыкает круг
+        void start(const uint16_t *words, std::size_t count, uint16_t length = 0) noexcept
+        {
+            words_ = words;
+            count_ = count < kMaxWords ? count : kMaxWords;
+            length_ = length;
+            cursor_ = 0;
+            priority_cursor_ = 0;
+            since_background_ = 0;
+            length_pending_ = false;
+            for (uint32_t &bits : pending_)
+                bits = 0;
+            pending_count_ = 0;
+            prev_ = LightLevel::Off;
+            symbol_pos_ = 0;
+            symbol_count_ = 0;
+        }
+
+        // Сколько приоритетных пакетов отправлять на один фоновый (0 - только круг)
+        void setPriorityShare(uint8_t share) noexcept { priority_share_ = share; }
+
+        uint8_t priorityShare() const noexcept { return priority_share_; }
+
+        // Отправить пакет index вне очереди (один раз)
+        void prioritize(std::size_t index) noexcept
+        {
+            if (index >= count_ || ((pending_[index / 32] >> (index % 32)) & 1u))
+                return;
+            pending_[index / 32] |= 1u << (index % 32);
+            ++pending_count_;
+        }
+
+        // Вне очереди - все пакеты, которых нет в карте приёма (BasicDecoder::receivedBitmap)
+        void prioritizeMissing(const uint32_t *received) noexcept
+        {
+            for (std::size_t i = 0; i < count_; ++i)
+            {
+                if (!((received[i / 32] >> (i % 32)) & 1u))
+                    prioritize(i);
+            }
+        }
+
+        // Вне очереди - служебный пакет длины (приёмник сообщил, что не знает длину)
+        void prioritizeLength() noexcept { length_pending_ = config().length_packet; }
+
+        // Сколько приоритетных пакетов ещё ждут отправки
+        std::size_t pendingCount() const noexcept { return pending_count_ + (length_pending_ ? 1 : 0); }
+
+        // Пишет до maxSymbols следующих символов в out; 0 - сообщение пустое
+        std::size_t next(SignalChange *out, std::size_t maxSymbols) noexcept
+        {
+            std::size_t written = 0;
+            while (written < maxSymbols)
+            {
+                if (symbol_pos_ == symbol_count_ && !loadPacket())
+                    break;
+                std::size_t count = symbol_count_ - symbol_pos_;
+                if (count > maxSymbols - written)
+                    count = maxSymbols - written;
+                for (std::size_t i = 0; i < count; ++i)
+                    out[written + i] = symbols_[symbol_pos_ + i];
+                symbol_pos_ += count;
+                written += count;
+            }
+            return written;
+        }
+
+    private:
+        bool loadPacket() noexcept
+        {
+            const bool meta = config().length_packet;
+            if (count_ == 0 && !meta)
+                return false;
+            const bool priorityTurn = pendingCount() != 0 && since_background_ < priority_share_;
+            if (priorityTurn && length_pending_)
+            {
+                length_pending_ = false;
+                ++since_background_;
+                loadMeta();
+                return true;
+            }
+            if (priorityTurn)
+            {
+                // приоритетные пакеты тоже идут по кругу, от последнего отправленного
+                while (!((pending_[priority_cursor_ / 32] >> (priority_cursor_ % 32)) & 1u))
+                    priority_cursor_ = priority_cursor_ + 1 == count_ ? 0 : priority_cursor_ + 1;
+                pending_[priority_cursor_ / 32] &= ~(1u << (priority_cursor_ % 32));
+                --pending_count_;
+                ++since_background_;
+                loadWord(priority_cursor_);
+                return true;
+            }
+            since_background_ = 0;
+            if (cursor_ == count_)
+            {
+                cursor_ = 0;
+                if (meta)
+                {
+                    loadMeta();
+                    return true;
+                }
+            }
+            loadWord(cursor_++);
+            return true;
+        }
+
+        void loadWord(std::size_t index) noexcept
+        {
+            prev_ = encodePacket<kPolynomial>(prev_, static_cast<uint8_t>(index), words_[index], config(), symbols_);
+            symbol_pos_ = 0;
+            symbol_count_ = symbolsPerPacket(config());
+        }
+
+        void loadMeta() noexcept
+        {
+            prev_ = encodeMetaPacket<kPolynomial>(prev_, kMetaLength, length_, config(), symbols_);
+            symbol_pos_ = 0;
+            symbol_count_ = symbolsPerPacket(config());
+        }
+
+        ProtocolConfig config_;
+        const uint16_t *words_;
+        std::size_t count_;
+        uint16_t length_;
+        std::size_t cursor_;          // следующий пакет круга
+        std::size_t priority_cursor_; // откуда искать следующий приоритетный
+        uint8_t priority_share_;
+        uint8_t since_background_;    // приоритетных подряд с последнего фонового
+        bool length_pending_;
+        uint32_t pending_[(kMaxWords + 31) / 32];
+        std::size_t pending_count_;
+        LightLevel prev_;
+        SignalChange symbols_[kSymbolsPerPacket];
+        std::size_t symbol_pos_;
+        std::size_t symbol_count_;
+    };
+
+    using Carousel = BasicCarousel<>;
+
+    // Драйвер передатчика: set_level выставляет уровень излучателя, arm запускает
+    // таймер так, чтобы через duration был вызван BasicTransmitter::onTimer.
+    // Точнее всего - таймер с регистром сравнения, который отсчитывает duration от
+    // предыдущего срабатывания, а не от входа в прерывание.
+    struct TransmitDriver
+    {
+        void (*set_level)(LightLevel level, void *context);
+        void (*arm)(long duration, void *context);
+        void *context;
+    };
+
+    // Передача по таймеру без циклов ожидания. Символы идут из StreamEncoder через
+    // два буфера по kChunkSymbols: прерывание таймера (onTimer) проигрывает один,
+    // а основной цикл (pump) заполняет другой. Следующее сообщение, переданное в
+    // send до конца кодирования текущего, продолжает его цепочку уровней без паузы:
+    // для декодера это один поток, и захват frame_sync не сбивается. Если ждать
+    // нечего, после сообщения идёт пауза Off в один символ, излучатель гаснет, и
+    // следующее сообщение начинается с Off.
+    // onTimer - единственный потребитель, send и pump - единственный производитель;
+    // их можно вызывать из разных контекстов без блокировок, если onTimer прерывает
+    // pump на том же ядре (прерывание таймера) или вызывается в том же потоке
+    // (HostTransmitter). Параллельно pump на другом ядре onTimer вызывать нельзя:
+    // между проверкой пустого буфера и остановкой таймера pump может заполнить
+    // буфер, увидеть таймер ещё работающим и не запустить передачу.
+    template <typename Protocol = DefaultProtocol>
+    class BasicTransmitter
+    {
+    public:
+        static constexpr std::size_t kChunkSymbols = 64;
+
+        explicit BasicTransmitter(const TransmitDriver &driver, const ProtocolConfig &config = Protocol::config) noexcept
+            : driver_(driver), encoder_(config), play_(0), play_pos_(0), play_size_(0), fill_(0), encoding_(false),
+              gap_pending_(false), last_(LightLevel::Off), has_next_(false), next_data_(nullptr), next_len_(0),
+              running_(false)
+        {
+            chunk_size_[0].store(0, std::memory_order_relaxed);
+            chunk_size_[1].store(0, std::memory_order_relaxed);
+        }
+
+        const ProtocolConfig &config() const noexcept { return encoder_.config(); }
+
+        // Ставит сообщение в очередь (буфер должен жить, пока оно не закодировано
+        // целиком - см. pending); передачу запускает следующий pump.
+        // false - одно сообщение уже ждёт.
+        bool send(const uint8_t *data, std::size_t len) noexcept
+        {
+            if (has_next_)
+                return false;
+            next_data_ = data;
+            next_len_ = len;
+            has_next_ = true;
+            return true;
+        }
+
+        // Заполняет свободные буферы и, если передача стоит, а символы есть, запускает
+        // её. Вызывать чаще, чем проигрывается буфер (kChunkSymbols символов), иначе
+        // передача прервётся. Возвращает true, пока есть что передавать.
+        bool pump() noexcept
+        {
+            while (chunk_size_[fill_].load(std::memory_order_acquire) == 0)
+            {
+                const std::size_t count = fillChunk(chunks_[fill_]);
+                if (count == 0)
+                    break;
+                // seq_cst в паре с onTimer: запись буфера не переставляется с чтением
+                // running_ ниже, и прерывание, пришедшее между ними, видит буфер
+                chunk_size_[fill_].store(count, std::memory_order_seq_cst);
+                fill_ ^= 1;
+            }
+            if (!running_.load(std::memory_order_seq_cst) &&
+                chunk_size_[play_].load(std::memory_order_acquire) != 0)
+            {
+                // таймер стоит, onTimer сейчас никто не вызовет - запускаем сами
+                running_.store(true, std::memory_order_relaxed);
+                onTimer();
+            }
+            return running_.load(std::memory_order_acquire) || encoding_ || has_next_;
+        }
+
+        // Из прерывания таймера: выставляет следующий символ и взводит таймер на его
+        // длительность. Когда символы кончились, гасит излучатель и не взводит таймер.
+        void onTimer() noexcept
+        {
+            if (play_pos_ == play_size_)
+            {
+                if (play_size_ != 0)
+                {
+                    chunk_size_[play_].store(0, std::memory_order_release);
+                    play_ ^= 1;
+                }
+                play_pos_ = 0;
+                play_size_ = chunk_size_[play_].load(std::memory_order_seq_cst);
+                if (play_size_ == 0)
+                {
+                    driver_.set_level(LightLevel::Off, driver_.context);
+                    running_.store(false, std::memory_order_seq_cst);
+                    return;
+                }
+            }
+            const SignalChange &sc = chunks_[play_][play_pos_++];
+            driver_.set_level(sc.value, driver_.context);
+            driver_.arm(sc.duration, driver_.context);
+        }
+
+        // Идёт ли передача (взведён ли таймер)
+        bool running() const noexcept { return running_.load(std::memory_order_acquire); }
+
+        // Ждёт ли сообщение из send начала кодирования (его буфер ещё нужен)
+        bool pending() const noexcept { return has_next_; }
+
+        // Нечего передавать и нечего кодировать
+        bool idle() const noexcept { return !running() && !encoding_ && !has_next_; }
+
+    private:
+        std::size_t fillChunk(SignalChange *out) noexcept
+        {
+            std::size_t count = 0;
+            while (count < kChunkSymbols)
+            {
+                if (gap_pending_)
+                {
+                    // пауза только после уровня, отличного от Off: повтор Off декодер и так пропустит
+                    if (last_ != LightLevel::Off)
+                        out[count++] = {LightLevel::Off, config().duration};
+                    last_ = LightLevel::Off;
+                    gap_pending_ = false;
+                    continue;
+                }
+                if (!encoding_)
+                {
+                    if (!has_next_)
+                        break;
+                    encoder_.start(next_data_, next_len_, last_);
+                    has_next_ = false;
+                    encoding_ = true;
+                }
+                count += encoder_.next(out + count, kChunkSymbols - count);
+                if (encoder_.done())
+                {
+                    encoding_ = false;
+                    last_ = encoder_.last();
+                    // следующее сообщение уже ждёт - оно продолжит цепочку, паузы нет
+                    gap_pending_ = !has_next_;
+                }
+            }
+            return count;
+        }
+
+        TransmitDriver driver_;
+        BasicStreamEncoder<Protocol> encoder_;
+        SignalChange chunks_[2][kChunkSymbols];
+        std::atomic<std::size_t> chunk_size_[2]; // 0 - буфер свободен для pump
+        // состояние onTimer
+        uint8_t play_;
+        std::size_t play_pos_;
+        std::size_t play_size_;
+        // состояние send/pump
+        uint8_t fill_;
+        bool encoding_;
+        bool gap_pending_;
+        LightLevel last_; // уровень последнего заполненного символа
+        bool has_next_;
+        const uint8_t *next_data_;
+        std::size_t next_len_;
+        std::atomic<bool> running_;
+    };
+
+    using Transmitter = BasicTransmitter<>;
+
+    using PacketCallback = void (*)(const UnpackedPackage &package, void *context);
+
+    // Очередь без блокировок для одного писателя и одного читателя (SPSC).
+    // Ёмкость фиксирована и должна быть степенью двойки; памяти не выделяет.
+    // Писатель - обработчик прерывания/поток с feed, читатель - приложение.
+    template <typename T, std::size_t Capacity>
+    class SpscQueue
+    {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        SpscQueue() noexcept : head_(0), tail_(0), dropped_(0) {}
+
+        constexpr std::size_t capacity() const noexcept { return Capacity; }
+
+        // Только писатель. false - очередь полна, элемент отброшен
+        bool push(const T &value) noexcept
+        {
+            const std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) == Capacity)
+            {
+                dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+            data_[tail & (Capacity - 1)] = value;
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Только читатель
+        bool pop(T &value) noexcept
+        {
+            const std::size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire))
+                return false;
+            value = data_[head & (Capacity - 1)];
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Только читатель: забирает всё накопленное за один проход, вызывая handler
+        // для каждого элемента. Возвращает число обработанных элементов.
+        template <typename Handler>
+        std::size_t drain(Handler &&handler)
+        {
+            const std::size_t head = head_.load(std::memory_order_relaxed);
+            const std::size_t tail = tail_.load(std::memory_order_acquire);
+            for (std::size_t i = head; i != tail; ++i)
+            {
+                handler(data_[i & (Capacity - 1)]);
+            }
+            head_.store(tail, std::memory_order_release);
+            return tail - head;
+        }
+
+        std::size_t size() const noexcept
+        {
+            return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+        }
+
+        bool empty() const noexcept { return size() == 0; }
+
+        // Сколько элементов отброшено из-за переполнения
+        std::size_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        alignas(64) std::atomic<std::size_t> head_;
+        alignas(64) std::atomic<std::size_t> tail_;
+        std::atomic<std::size_t> dropped_;
+        T data_[Capacity];
+    };
+
+    constexpr std::size_t kPacketQueueCapacity = 256;
+
+    using PacketQueue = SpscQueue<UnpackedPackage, kPacketQueueCapacity>;
+
+    // Забирает из очереди все пакеты и передаёт их callback вместе с context
+    inline std::size_t drainPackets(PacketQueue &queue, PacketCallback callback, void *context = nullptr)
+    {
+        return queue.drain([callback, context](const UnpackedPackage &package) { callback(package, context); });
+    }
+
+    // Участок памяти декодера; действует, пока декодер не перезапишет буфер
+    struct ByteView
+    {
+        const uint8_t *data;
+        std::size_t size;
+
+#ifdef __cpp_lib_span
+        std::span<const uint8_t> span() const noexcept { return {data, size}; }
+#endif
+    };
+
+    // Сообщение собрано целиком: data - полезные данные (с FEC - уже восстановленные)
+    using MessageCallback = void (*)(const uint8_t *data, std::size_t len, void *context);
+
+    // Счётчики декодера (Protocol::statistics). Все - с момента resetStatistics().
+    struct DecoderStats
+    {
+        uint32_t symbols = 0;      // переходов подано в feed
+        uint32_t glitches = 0;     // отброшено как короче порога или вне алфавита
+        uint32_t repeats = 0;      // отброшено как повтор того же уровня
+        uint32_t crc_pass = 0;     // проверок CRC с совпадением (включая кандидатов синхронизации)
+        uint32_t crc_fail = 0;     // проверок CRC без совпадения
+        uint32_t packets = 0;      // пакетов выдано приложению
+        uint32_t duplicates = 0;   // из них повторили уже принятое слово
+        uint32_t rewrites = 0;     // из них заменили принятое слово другим
+        uint32_t out_of_range = 0; // пакетов с индексом вне max_words
+        uint32_t meta_packets = 0; // служебных пакетов (length_packet)
+        uint32_t sync_losses = 0;  // потерь захвата границ (frame_sync)
+    };
+
+    namespace detail
+    {
+        // Хранилище счётчиков. Без статистики - пустая база, декодер не растёт.
+        template <bool Enabled>
+        class DecoderCounters
+        {
+        protected:
+            void addStatistics(const DecoderStats &) noexcept {}
+            DecoderStats loadStatistics() const noexcept { return {}; }
+            void clearStatistics() noexcept {}
+        };
+
+        // Пишет только поток feed, поэтому хватает relaxed load/store без RMW;
+        // снимок из другого потока видит каждое поле целиком.
+        template <>
+        class DecoderCounters<true>
+        {
+        public:
+            DecoderCounters() noexcept { clearStatistics(); }
+            DecoderCounters(const DecoderCounters &other) noexcept { store(other.loadStatistics()); }
+            DecoderCounters &operator=(const DecoderCounters &other) noexcept
+            {
+                store(other.loadStatistics());
+                return *this;
+            }
+
+        protected:
+            static constexpr std::size_t kFields = sizeof(DecoderStats) / sizeof(uint32_t);
+
+            void addStatistics(const DecoderStats &delta) noexcept
+            {
+                uint32_t values[kFields];
+                std::memcpy(values, &delta, sizeof(values));
+                for (std::size_t k = 0; k < kFields; ++k)
+                {
+                    if (values[k] != 0)
+                        value_[k].store(value_[k].load(std::memory_order_relaxed) + values[k], std::memory_order_relaxed);
+                }
+            }
+
+            DecoderStats loadStatistics() const noexcept
+            {
+                uint32_t values[kFields];
+                for (std::size_t k = 0; k < kFields; ++k)
+                    values[k] = value_[k].load(std::memory_order_relaxed);
+                DecoderStats stats;
+                std::memcpy(&stats, values, sizeof(values));
+                return stats;
+            }
+
+            void clearStatistics() noexcept { store(DecoderStats()); }
+
+        private:
+            void store(const DecoderStats &stats) noexcept
+            {
+                uint32_t values[kFields];
+                std::memcpy(values, &stats, sizeof(values));
+                for (std::size_t k = 0; k < kFields; ++k)
+                    value_[k].store(values[k], std::memory_order_relaxed);
+            }
+
+            std::atomic<uint32_t> value_[kFields];
+        };
+    }
+
+    namespace detail
+    {
+        struct LegacyGlobals; // глобальные window, prev_value и receive_buffer (см. конец файла)
+    }
+
+    // Декодер одного канала. Всё состояние принадлежит экземпляру, поэтому
+    // разные декодеры можно кормить из разных потоков без синхронизации.
+    template <typename Protocol = DefaultProtocol>
+    class BasicDecoder : private detail::DecoderCounters<Protocol::statistics>
+    {
+        friend struct detail::LegacyGlobals;
+
+    public:
+        static constexpr std::size_t kMaxWords = Protocol::max_words;
+        static constexpr uint8_t kPolynomial = Protocol::crc_polynomial;
+        static constexpr bool kStatistics = Protocol::statistics;
+        static_assert(kMaxWords > 0 && kMaxWords <= 256, "индекс пакета - один байт");
+
+        explicit BasicDecoder(PacketCallback callback = nullptr, void *context = nullptr,
+                              const ProtocolConfig &config = Protocol::config) noexcept
+            : config_(config), callback_(callback), context_(context), queue_(nullptr), message_callback_(nullptr),
+              message_context_(nullptr), spare_(nullptr), swapped_(false), trace_(nullptr), trace_clock_(nullptr)
+        {
+            reset();
+        }
+
+        // Действующие настройки: при fixed_config - константы протокола
+        const ProtocolConfig &config() const noexcept
+        {
+            if constexpr (Protocol::fixed_config)
+                return Protocol::config;
+            else
+                return config_;
+        }
+
+        void setConfig(const ProtocolConfig &config) noexcept
+        {
+            config_ = config;
+            tick_q8_ = this->config().duration << 8;
+        }
+
+        void setCallback(PacketCallback callback, void *context = nullptr) noexcept
+        {
+            callback_ = callback;
+            context_ = context;
+        }
+
+        // Вызывается один раз, когда известна длина сообщения (length_packet) и приняты
+        // (или восстановлены по FEC) все его слова. Следующее сообщение декодер
+        // распознаёт сам: с frame_sync - по другим словам или длине, без него - только
+        // по другой длине. Без frame_sync ложное совпадение CRC на невыровненном окне
+        // может подменить слово, и собранное сообщение не гарантированно верно.
+        void setMessageCallback(MessageCallback callback, void *context = nullptr) noexcept
+        {
+            message_callback_ = callback;
+            message_context_ = context;
+        }
+
+        // Двойная буферизация: words - запасной буфер на kMaxWords слов. Собранное
+        // сообщение остаётся в одном буфере (messageView), а следующее тут же
+        // начинает приниматься в другой. nullptr отключает режим.
+        void setSpareBuffer(uint16_t *words) noexcept
+        {
+            spare_ = words;
+            swapped_ = false;
+            has_message_ = false;
+        }
+
+        // Принятые пакеты дополнительно складываются в queue; обработка уходит
+        // в поток приложения (drainPackets), а feed не ждёт её завершения.
+        // Декодер должен быть единственным писателем очереди.
+        void setQueue(PacketQueue *queue) noexcept { queue_ = queue; }
+
+        // Трасса: каждый переход (с окном и итогом CRC) и каждый выданный пакет
+        // пишутся в ring. Часы читаются на каждый переход и в пачке: отметка
+        // перехода - время его разбора в feed, пакета - время перед коллбэком.
+        // Без форматирования, годится для прерывания; nullptr отключает.
+        // Действует, только если включён Protocol::tracing: иначе кода трассы в feed нет.
+        void setTrace(TraceRing *ring, TraceClock clock) noexcept
+        {
+            trace_ = ring;
+            trace_clock_ = clock;
+        }
+
+        // Возвращает true, если переход завершил корректный пакет
+        bool feed(SignalChange sc) noexcept
+        {
+            return feed(&sc, 1) != 0;
+        }
+
+        // Декодирует пачку переходов за один вызов. Окно и предыдущий уровень
+        // держатся в локальных переменных до конца пачки. Найденные пакеты
+        // (не больше maxPackets) копируются в packets; возвращает их общее число.
+        // В positions (если задан, тоже на maxPackets) - номер перехода в signals,
+        // на котором пакет был выдан.
+        std::size_t feed(const SignalChange *signals, std::size_t count, UnpackedPackage *packets = nullptr,
+                         std::size_t maxPackets = 0, std::size_t *positions = nullptr) noexcept
+        {
+            uint32_t window = window_;
+            LightLevel prev = prev_value_;
+            uint8_t segment = segment_;
+            UnpackedPackage candidate = candidate_;
+            uint32_t candidate_age = candidate_age_;
+            bool locked = locked_;
+            uint32_t since_sync = since_sync_;
+            uint32_t sync_misses = sync_misses_;
+            const bool clockRecovery = config().clock_recovery;
+            long tickQ8 = tick_q8_;
+            long tick = clockRecovery ? (tickQ8 + 128) >> 8 : config().duration;
+            // порог глитчей держит то же отношение к тику, что в config
+            const int64_t minRatio = config().duration > 0
+                                         ? (static_cast<int64_t>(config().min_duration) << 16) / config().duration
+                                         : 0;
+            long minDuration = clockRecovery ? static_cast<long>((tickQ8 * minRatio) >> 24) : config().min_duration;
+            const bool segmented = config().segmented;
+            const bool frameSync = config().frame_sync;
+            const bool lengthPacket = config().length_packet;
+            const bool intensity = config().modulation == Modulation::Intensity4;
+            const bool runLength = config().run_length && !intensity;
+            const unsigned shift = symbolBits(config());
+            const uint32_t packetSymbols = static_cast<uint32_t>(symbolsPerPacket(config()));
+            std::size_t found = 0;
+            DecoderStats delta;
+            if constexpr (kStatistics)
+                delta.symbols = static_cast<uint32_t>(count);
+            TraceRing *const trace = trace_;
+            const TraceClock traceClock = trace_clock_;
+            TraceRecord *traced = nullptr; // запись текущего перехода, итог CRC дописывается позже
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const SignalChange &sc = signals[i];
+                // уровень вне классического алфавита (например, ступень Intensity4) -
+                // помеха, как и у MultiDecoder; окно и prev он не трогает
+                const bool foreign = !intensity && static_cast<uint8_t>(sc.value) >= detail::kLevelCount;
+                if (sc.duration < minDuration || foreign || sc.value == prev)
+                {
+                    if constexpr (kStatistics)
+                        ++(sc.duration < minDuration || foreign ? delta.glitches : delta.repeats);
+                    if (Protocol::tracing && trace)
+                        trace->push_back({traceClock ? traceClock() : 0, static_cast<int32_t>(sc.duration), window,
+                                          static_cast<uint8_t>(TraceEvent::Filtered), static_cast<uint8_t>(sc.value),
+                                          static_cast<uint8_t>(TraceCrc::Skipped), 0});
+                    continue;
+                }
+
+                const uint8_t run = runLength ? quantizeRun(sc.duration, tick) : 1;
+                if (clockRecovery)
+                {
+                    // Фазовой автоподстройки нет: тик - скользящее среднее длительности
+                    // одного тика. Выбросы дальше четверти тика (шум, соседняя длина
+                    // run_length) оценку не трогают.
+                    const long error = (sc.duration << 8) / run - tickQ8;
+                    if (error < tickQ8 / 4 && error > -tickQ8 / 4)
+                    {
+                        tickQ8 += error / kClockGain;
+                        tick = (tickQ8 + 128) >> 8;
+                        minDuration = static_cast<long>((tickQ8 * minRatio) >> 24);
+                    }
+                }
+
+                uint32_t bits;
+                if (intensity)
+                {
+                    bits = getIntensityDigit(prev, sc.value);
+                }
+                else
+                {
+                    bits = static_cast<uint8_t>(getDbit(prev, sc.value));
+                    if (runLength)
+                        bits = (bits << 2) | (run - 1u);
+                }
+                window = (window << shift) | bits;
+                prev = sc.value;
+                if (Protocol::tracing && trace)
+                {
+                    trace->push_back({traceClock ? traceClock() : 0, static_cast<int32_t>(sc.duration), window,
+                                      static_cast<uint8_t>(TraceEvent::Symbol), static_cast<uint8_t>(sc.value),
+                                      static_cast<uint8_t>(TraceCrc::Skipped), 0});
+                    traced = &trace->back();
+                }
+
+                if (segmented)
+                    ++candidate_age;
+                if (frameSync)
+                {
+                    ++since_sync;
+                    // В захвате окно выровнено по пакету раз в packetSymbols переходов.
+                    // CRC проверяется и на переходе раньше (выпал символ), а после
+                    // промаха на границе - на всех сдвигах, пока граница не найдётся.
+                    if (locked && sync_misses == 0 && (since_sync + 1) % packetSymbols > 1)
+                        continue;
+                }
+
+                bool confirmed = false;
+                UnpackedPackage package = unpack_and_check<kPolynomial>(window, segment);
+                if (segmented && !package.valid)
+                {
+                    // Пакет следующего сегмента. Одиночное совпадение CRC легко
+                    // получить на невыровненном окне, поэтому сегмент сменяется,
+                    // только когда следом приходит пакет с соседним индексом.
+                    UnpackedPackage next = unpack_and_check<kPolynomial>(window, static_cast<uint8_t>(segment + 1));
+                    if (next.valid)
+                    {
+                        if (candidate.valid && candidate_age % packetSymbols == 0 &&
+                            next.index == static_cast<uint8_t>(candidate.index + candidate_age / packetSymbols))
+                        {
+                            segment = next.segment;
+                            accept(candidate, packets, positions, i, found, maxPackets, delta);
+                            candidate.valid = false;
+                            package = next;
+                            confirmed = true;
+                        }
+                        else
+                        {
+                            candidate = next;
+                            candidate_age = 0;
+                        }
+                    }
+                }
+                if (segmented && candidate_age > kSegmentConfirmWindow)
+                    candidate.valid = false;
+
+                if (!package.valid && lengthPacket)
+                {
+                    // тип и допустимая длина отсекают почти все случайные совпадения CRC
+                    const UnpackedPackage meta = unpack_and_check<kPolynomial>(window, static_cast<uint8_t>(segment ^ kMetaSegmentFlag));
+                    if (meta.valid && meta.index == kMetaLength && meta.word <= kMaxWords * 2)
+                    {
+                        if constexpr (kStatistics)
+                        {
+                            ++delta.crc_pass;
+                            ++delta.meta_packets;
+                        }
+                        if (traced)
+                            traced->crc = static_cast<uint8_t>(TraceCrc::Meta);
+                        if (frameSync)
+                        {
+                            // Служебный пакет - тоже граница: подтверждает кандидата за
+                            // пакет до него (последнее слово после сдвига фазы), а в
+                            // захвате переносит границу на себя.
+                            const bool paired = confirmSync(since_sync, packetSymbols, packets, positions, i, found,
+                                                            maxPackets, delta);
+                            if (paired || (locked && (sync_misses == 0 || since_sync % packetSymbols == 0)))
+                                relock(locked, sync_misses, since_sync);
+                        }
+                        setMessageLength(meta.word);
+                        continue;
+                    }
+                }
+
+                if (!package.valid)
+                {
+                    if constexpr (kStatistics)
+                        ++delta.crc_fail;
+                    if (traced)
+                        traced->crc = static_cast<uint8_t>(TraceCrc::Fail);
+                    // Промах на границе: со следующего перехода CRC проверяется на всех
+                    // сдвигах, и пакет со сдвинутой фазой подтверждается соседом, как при
+                    // поиске. На прежней границе пакеты принимаются, пока промахов меньше
+                    // kSyncLossPackets, - одиночный испорченный пакет захват не сбрасывает.
+                    if (locked && since_sync % packetSymbols == 0 && ++sync_misses >= kSyncLossPackets)
+                    {
+                        locked = false;
+                        if constexpr (kStatistics)
+                            ++delta.sync_losses;
+                    }
+                    continue;
+                }
+                if constexpr (kStatistics)
+                    ++delta.crc_pass;
+                if (traced)
+                    traced->crc = static_cast<uint8_t>(TraceCrc::Pass);
+
+                if (frameSync)
+                {
+                    // Вне захваченной границы (поиск, соседний сдвиг) пакет принимается,
+                    // только если через пакет за ним идёт ещё один корректный. Кандидаты
+                    // хранятся по фазе, чтобы ложное совпадение CRC на другом сдвиге не
+                    // вытесняло настоящий пакет.
+                    if (!confirmed && (!locked || since_sync % packetSymbols != 0) &&
+                        !confirmSync(since_sync, packetSymbols, packets, positions, i, found, maxPackets, delta))
+                    {
+                        const uint32_t phase = since_sync % packetSymbols;
+                        sync_candidates_[phase] = package;
+                        sync_stamps_[phase] = since_sync;
+                        continue;
+                    }
+                    relock(locked, sync_misses, since_sync);
+                }
+
+                accept(package, packets, positions, i, found, maxPackets, delta);
+            }
+
+            window_ = window;
+            prev_value_ = prev;
+            tick_q8_ = tickQ8;
+            segment_ = segment;
+            candidate_ = candidate;
+            candidate_age_ = candidate_age;
+            locked_ = locked;
+            since_sync_ = since_sync;
+            sync_misses_ = sync_misses;
+            if constexpr (kStatistics)
+                this->addStatistics(delta);
+            return found;
+        }
+
+#ifdef __cpp_lib_span
+        std::size_t feed(std::span<const SignalChange> signals, std::span<UnpackedPackage> packets = {}) noexcept
+        {
+            return feed(signals.data(), signals.size(), packets.data(), packets.size());
+        }
+#endif
+
+        const uint16_t *receivedWords() const noexcept { return activeWords(); }
+
+        // Текущий сегмент (режим segmented)
+        uint8_t segment() const noexcept { return segment_; }
+
+        // Оценка тика передатчика (режим clock_recovery), иначе config().duration
+        long tickEstimate() const noexcept
+        {
+            return config().clock_recovery ? (tick_q8_ + 128) >> 8 : config().duration;
+        }
+
+        // Порог глитчей, подстроенный под tickEstimate()
+        long glitchThreshold() const noexcept
+        {
+            if (!config().clock_recovery || config().duration <= 0)
+                return config().min_duration;
+            return static_cast<long>(static_cast<int64_t>(tick_q8_) * config().min_duration / config().duration >> 8);
+        }
+
+        // Снимок счётчиков (нули, если Protocol::statistics выключен). Можно вызывать
+        // из другого потока, пока идёт feed: каждое поле согласовано само по себе.
+        DecoderStats statistics() const noexcept { return this->loadStatistics(); }
+
+        void resetStatistics() noexcept { this->clearStatistics(); }
+
+        // Захвачены ли границы пакетов (режим frame_sync)
+        bool locked() const noexcept { return locked_; }
+
+        // Копирует принятые данные в data (до kMaxWords * 2 байт), возвращает их длину.
+        // С fec_group выдаются только слова данных, утерянные восстанавливаются по чётности.
+        std::size_t getReceivedData(uint8_t *data) const noexcept
+        {
+            const uint16_t *words = activeWords();
+            std::size_t count = kMaxWords;
+            uint16_t recovered[kMaxWords];
+            if (config().fec_group != 0)
+            {
+                count = recoverFec(recovered);
+                words = recovered;
+            }
+            std::size_t index = 0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                uint16_t word = words[i];
+                data[index++] = word & 0xFF;
+                data[index++] = (word >> 8) & 0xFF;
+            }
+            return index;
+        }
+
+#if DATAPACK_LITTLE_ENDIAN
+        // То же, что getReceivedData(data, maxLen), но без копирования: указатель в буфер
+        // приёма. С fec_group данные перемежаются с чётностью, и вид пуст - см. messageView.
+        ByteView receivedView() const noexcept
+        {
+            if (config().fec_group != 0)
+                return {bytesOf(activeWords()), 0};
+            std::size_t size = (complete_ ? (message_length_ + 1) / 2 : receivedPrefixWords()) * 2;
+            if (complete_ && size > message_length_)
+                size = message_length_;
+            return {bytesOf(activeWords()), size};
+        }
+
+        // Последнее собранное сообщение (length_packet) без копирования. С запасным
+        // буфером действует до сборки следующего, без него - до reset(); с fec_group
+        // доступно только в режиме двойной буферизации.
+        ByteView messageView() const noexcept
+        {
+            if (!has_message_)
+                return {nullptr, 0};
+            return {bytesOf(spare_ ? inactiveWords() : activeWords()), message_size_};
+        }
+#endif
+
+        bool isReceived(std::size_t index) const noexcept
+        {
+            return index < kMaxWords && (received_[index / 32] >> (index % 32)) & 1u;
+        }
+
+        // Есть ли слово данных dataIndex: принято или (с fec_group) восстановимо по чётности
+        bool isRecoverable(std::size_t dataIndex) const noexcept
+        {
+            if (config().fec_group == 0 || !fecValid(config().fec_group, config().fec_depth, kMaxWords))
+                return isReceived(dataIndex);
+            return dataIndex < fecDataCapacity(config().fec_group, config().fec_depth, kMaxWords) &&
+                   wordRecoverable(dataIndex);
+        }
+
+        // Битовая карта принятых индексов: бит i % 32 слова i / 32
+        const uint32_t *receivedBitmap() const noexcept { return received_; }
+
+        // Сколько различных индексов принято
+        std::size_t receivedCount() const noexcept { return received_count_; }
+
+        // Сколько слов подряд с индекса 0 уже принято
+        std::size_t receivedPrefixWords() const noexcept
+        {
+            std::size_t count = 0;
+            while (count < kMaxWords && isReceived(count))
+                ++count;
+            return count;
+        }
+
+        bool hasMessageLength() const noexcept { return has_length_; }
+
+        // Длина сообщения в байтах из служебного пакета (см. hasMessageLength)
+        std::size_t messageLength() const noexcept { return message_length_; }
+
+        bool complete() const noexcept { return complete_; }
+
+        // Копирует только достоверные данные, не больше maxLen байт: всё сообщение,
+        // если оно собрано, иначе принятый без пропусков префикс. Возвращает длину.
+        std::size_t getReceivedData(uint8_t *data, std::size_t maxLen) const noexcept
+        {
+            uint16_t words[kMaxWords];
+            std::size_t available;
+            if (config().fec_group != 0)
+            {
+                std::size_t lost = 0;
+                available = recoverFec(words, &lost) * 2;
+                if (!complete_)
+                {
+                    // без полной картины годится только префикс до первого невосстановленного слова
+                    std::size_t prefix = 0;
+                    while (prefix * 2 < available && wordRecoverable(prefix))
+                        ++prefix;
+                    available = prefix * 2;
+                }
+            }
+            else
+            {
+                for (std::size_t i = 0; i < kMaxWords; ++i)
+                    words[i] = activeWords()[i];
+                available = (complete_ ? (message_length_ + 1) / 2 : receivedPrefixWords()) * 2;
+            }
+            if (complete_ && available > message_length_)
+                available = message_length_;
+            if (available > maxLen)
+                available = maxLen;
+            for (std::size_t i = 0; i < available; ++i)
+            {
+                const uint16_t word = words[i / 2];
+                data[i] = (i % 2 == 0) ? static_cast<uint8_t>(word & 0xFF) : static_cast<uint8_t>(word >> 8);
+            }
+            return available;
+        }
+
+        // Восстанавливает слова данных блоков FEC до последнего принятого пакета
+        // в data; возвращает их число. lost - сколько слов восстановить не удалось.
+        std::size_t recoverFec(uint16_t *data, std::size_t *lost = nullptr) const noexcept
+        {
+            std::size_t last = kMaxWords;
+            while (last > 0 && !isReceived(last - 1))
+                --last;
+            const std::size_t blockWords = fecBlockWords(config().fec_group, config().fec_depth);
+            return recoverFecBlocks(data, last == 0 ? 0 : (last - 1) / blockWords + 1, lost);
+        }
+
+    private:
+        std::size_t recoverFecBlocks(uint16_t *data, std::size_t blocks, std::size_t *lost) const noexcept
+        {
+            const std::size_t group = config().fec_group;
+            const std::size_t depth = config().fec_depth;
+            if (lost)
+                *lost = 0;
+            if (!fecValid(group, depth, kMaxWords) || blocks == 0)
+                return 0;
+            if (blocks > kMaxWords / fecBlockWords(group, depth))
+                blocks = kMaxWords / fecBlockWords(group, depth);
+            const std::size_t unrecovered = fecDecode(
+                activeWords(), [this](std::size_t index) { return isReceived(index); }, blocks, group, depth, data);
+            if (lost)
+                *lost = unrecovered;
+            return blocks * depth * group;
+        }
+
+        // Восстановимо ли слово данных dataIndex (режим FEC)
+        bool wordRecoverable(std::size_t dataIndex) const noexcept
+        {
+            const std::size_t group = config().fec_group;
+            const std::size_t depth = config().fec_depth;
+            const std::size_t block = dataIndex / (depth * group);
+            const std::size_t base = block * fecBlockWords(group, depth);
+            const std::size_t g = (dataIndex % (depth * group)) % depth;
+            if (isReceived(base + dataIndex % (depth * group)))
+                return true;
+            // каждая пропажа в группе g закрывается своим словом чётности (P или Q)
+            std::size_t missing = 0;
+            for (std::size_t i = 0; i < group; ++i)
+                missing += !isReceived(base + i * depth + g);
+            const std::size_t parity = isReceived(base + depth * group + g) + isReceived(base + depth * (group + 1) + g);
+            return missing <= parity;
+        }
+
+        // Есть ли кандидат поиска ровно за пакет до since_sync на той же фазе;
+        // если есть - выдаёт его
+        bool confirmSync(uint32_t since_sync, uint32_t packetSymbols, UnpackedPackage *packets,
+                         std::size_t *positions, std::size_t position, std::size_t &found,
+                         std::size_t maxPackets, DecoderStats &delta) noexcept
+        {
+            UnpackedPackage &candidateAt = sync_candidates_[since_sync % packetSymbols];
+            if (!candidateAt.valid || sync_stamps_[since_sync % packetSymbols] + packetSymbols != since_sync)
+                return false;
+            accept(candidateAt, packets, positions, position, found, maxPackets, delta);
+            return true;
+        }
+
+        // Граница пакета - здесь; счёт переходов начинается заново, поэтому отметки
+        // кандидатов устаревают
+        void relock(bool &locked, uint32_t &sync_misses, uint32_t &since_sync) noexcept
+        {
+            locked = true;
+            sync_misses = 0;
+            since_sync = 0;
+            for (UnpackedPackage &stale : sync_candidates_)
+                stale.valid = false;
+        }
+
+        // Служебный пакет закрывает сообщение. Другая длина - значит, и сообщение
+        // другое (reset между сообщениями не нужен).
+        void setMessageLength(uint16_t length) noexcept
+        {
+            if (has_length_ && length != message_length_)
+                dropStaleWords();
+            for (uint32_t &bits : since_length_)
+                bits = 0;
+            if (has_length_ && length == message_length_)
+                return;
+            has_length_ = true;
+            message_length_ = length;
+            checkComplete();
+        }
+
+        void checkComplete() noexcept
+        {
+            if (complete_ || !has_length_)
+                return;
+            const std::size_t group = config().fec_group;
+            const std::size_t dataWords = (message_length_ + 1) / 2;
+            if (received_count_ < dataWords)
+                return;
+            if (group == 0)
+            {
+                if (dataWords > kMaxWords)
+                    return;
+                for (std::size_t i = 0; i < dataWords; ++i)
+                {
+                    if (!isReceived(i))
+                        return;
+                }
+            }
+            else
+            {
+                if (!fecValid(group, config().fec_depth, kMaxWords) ||
+                    dataWords > fecDataCapacity(group, config().fec_depth, kMaxWords))
+                    return;
+                for (std::size_t i = 0; i < dataWords; ++i)
+                {
+                    if (!wordRecoverable(i))
+                        return;
+                }
+            }
+            complete_ = true;
+            publishMessage(dataWords);
+        }
+
+        void publishMessage(std::size_t dataWords) noexcept
+        {
+            const std::size_t group = config().fec_group;
+            const std::size_t length = message_length_;
+#if DATAPACK_LITTLE_ENDIAN
+            if (spare_ || group == 0)
+            {
+                if (spare_)
+                {
+                    if (group == 0)
+                        swapped_ = !swapped_; // собранные слова уже лежат в буфере, меняем лишь роли
+                    else
+                        recoverFecBlocks(inactiveWords(),
+                                         fecEncodedWords(dataWords, group, config().fec_depth) /
+                                             fecBlockWords(group, config().fec_depth),
+                                         nullptr);
+                }
+                has_message_ = true;
+                message_size_ = length;
+                if (message_callback_)
+                {
+                    const ByteView message = messageView();
+                    message_callback_(message.data, message.size, message_context_);
+                }
+                if (spare_)
+                    clearMessage();
+                return;
+            }
+#else
+            (void)dataWords;
+#endif
+            if (message_callback_)
+            {
+                uint8_t bytes[kMaxWords * 2];
+                const std::size_t len = getReceivedData(bytes, sizeof(bytes));
+                message_callback_(bytes, len, message_context_);
+            }
+            if (spare_)
+                clearMessage();
+        }
+
+        // Началось другое сообщение: слова, принятые до последнего служебного пакета,
+        // относятся к старому и из карты приёма убираются, длина старого забывается
+        void dropStaleWords() noexcept
+        {
+            received_count_ = 0;
+            for (std::size_t i = 0; i < (kMaxWords + 31) / 32; ++i)
+            {
+                received_[i] = since_length_[i];
+                for (uint32_t bits = since_length_[i]; bits != 0; bits &= bits - 1)
+                    ++received_count_;
+            }
+            message_length_ = 0;
+            has_length_ = false;
+            complete_ = false;
+        }
+
+        // Состояние приёма сообщения; синхронизация и сегмент сохраняются
+        void clearMessage() noexcept
+        {
+            for (uint32_t &bits : received_)
+                bits = 0;
+            for (uint32_t &bits : since_length_)
+                bits = 0;
+            received_count_ = 0;
+            message_length_ = 0;
+            has_length_ = false;
+            complete_ = false;
+        }
+
+        uint16_t *activeWords() noexcept { return swapped_ ? spare_ : receive_buffer_; }
+        const uint16_t *activeWords() const noexcept { return swapped_ ? spare_ : receive_buffer_; }
+        const uint16_t *inactiveWords() const noexcept { return swapped_ ? receive_buffer_ : spare_; }
+        uint16_t *inactiveWords() noexcept { return swapped_ ? receive_buffer_ : spare_; }
+
+        static const uint8_t *bytesOf(const uint16_t *words) noexcept
+        {
+            return reinterpret_cast<const uint8_t *>(words);
+        }
+
+    public:
+
+        // Граница сообщения: захват frame_sync и номер сегмента начинаются заново,
+        // кандидаты поиска забываются. Окно и предыдущий уровень сохраняются, так
+        // что следующее сообщение может продолжать цепочку уровней без паузы.
+        void restartSync() noexcept
+        {
+            segment_ = 0;
+            candidate_ = {false, 0, 0, 0};
+            candidate_age_ = 0;
+            locked_ = false;
+            since_sync_ = 0;
+            sync_misses_ = 0;
+            for (UnpackedPackage &candidate : sync_candidates_)
+                candidate = {false, 0, 0, 0};
+        }
+
+        void reset() noexcept
+        {
+            swapped_ = false;
+            for (uint16_t &word : receive_buffer_)
+                word = 0;
+            window_ = 12345678;
+            tick_q8_ = config().duration << 8;
+            prev_value_ = LightLevel::Off;
+            restartSync();
+            clearMessage();
+            has_message_ = false;
+            message_size_ = 0;
+        }
+
+    private:
+        ProtocolConfig config_;
+        PacketCallback callback_;
+        void *context_;
+        PacketQueue *queue_;
+        uint32_t window_;
+        LightLevel prev_value_;
+        long tick_q8_; // оценка тика, 1/256 единицы длительности
+        // на сколько переходов может отстоять подтверждение нового сегмента
+        static constexpr uint32_t kSegmentConfirmWindow = 4 * kSymbolsPerPacket;
+        // оценка тика сдвигается на 1/kClockGain ошибки за переход
+        static constexpr long kClockGain = 16;
+        // сколько выровненных позиций подряд без пакета означают потерю границ
+        static constexpr uint32_t kSyncLossPackets = 2;
+
+        void accept(const UnpackedPackage &package, UnpackedPackage *packets, std::size_t *positions,
+                    std::size_t position, std::size_t &found, std::size_t maxPackets, DecoderStats &delta) noexcept
+        {
+            if (package.index >= kMaxWords)
+            {
+                if constexpr (kStatistics)
+                    ++delta.out_of_range;
+                return; // индекс вне буфера этого протокола - пакет чужого сообщения
+            }
+            if constexpr (kStatistics)
+            {
+                ++delta.packets;
+                if (isReceived(package.index))
+                    ++(activeWords()[package.index] == package.word ? delta.duplicates : delta.rewrites);
+            }
+            // После служебного пакета слово с тем же индексом, но другое - пакет
+            // следующего сообщения (повтор того же сообщения слов не меняет). Без
+            // frame_sync так же выглядит ложное совпадение CRC, и сообщение там
+            // сменяется только по длине (setMessageLength).
+            if (config().frame_sync && has_length_ && isReceived(package.index) &&
+                activeWords()[package.index] != package.word)
+                dropStaleWords();
+            activeWords()[package.index] = package.word;
+            if (!isReceived(package.index))
+            {
+                received_[package.index / 32] |= 1u << (package.index % 32);
+                ++received_count_;
+            }
+            since_length_[package.index / 32] |= 1u << (package.index % 32);
+            if (found < maxPackets)
+            {
+                if (packets)
+                    packets[found] = package;
+                if (positions)
+                    positions[found] = position;
+            }
+            ++found;
+            if constexpr (Protocol::tracing)
+                detail::trace(trace_, trace_clock_, TraceEvent::Packet, 0,
+                              static_cast<uint32_t>(package.segment) << 24 | static_cast<uint32_t>(package.index) << 16 |
+                                  package.word,
+                              TraceCrc::Pass);
+            if (queue_)
+                queue_->push(package);
+            if (callback_)
+                callback_(package, context_);
+            checkComplete();
+        }
+
+        uint8_t segment_;
+        UnpackedPackage candidate_; // первый пакет предполагаемого нового сегмента
+        uint32_t candidate_age_;
+        bool locked_;               // границы пакетов захвачены
+        uint32_t since_sync_;       // переходов с последнего принятого пакета
+        uint32_t sync_misses_;      // подряд пропущенных пакетов в захвате
+        UnpackedPackage sync_candidates_[kSymbolsPerPacket]; // кандидаты поиска по фазе
+        uint32_t sync_stamps_[kSymbolsPerPacket];
+        uint16_t receive_buffer_[kMaxWords];
+        uint32_t received_[(kMaxWords + 31) / 32]; // какие индексы текущего сообщения приняты
+        uint32_t since_length_[(kMaxWords + 31) / 32]; // ... и после последнего служебного пакета
+        std::size_t received_count_;
+        std::size_t message_length_;
+        bool has_length_;
+        bool complete_;
+        MessageCallback message_callback_;
+        void *message_context_;
+        uint16_t *spare_;      // запасной буфер двойной буферизации
+        bool swapped_;         // приём идёт в spare_, а receive_buffer_ хранит сообщение
+        bool has_message_;
+        std::size_t message_size_;
+        TraceRing *trace_;
+        TraceClock trace_clock_;
+    };
+
+    using Decoder = BasicDecoder<>;
+
+    namespace detail
+    {
+        // Синдром CRC окна: 0 - пакет сегмента 0 корректен. CRC линейна, поэтому синдром
+        // складывается из вкладов полубайтов окна; таблицы по 16 байт годятся для pshufb/tbl.
+        // [k][0] - младший, [k][1] - старший полубайт байта k окна (1 - data high,
+        // 2 - data low, 3 - index); байт 0 (принятая CRC) входит в синдром как есть.
+        struct SyndromeTables
+        {
+            alignas(16) uint8_t value[4][2][16];
+        };
+
+        template <uint8_t Polynomial>
+        constexpr SyndromeTables makeSyndromeTables()
+        {
+            SyndromeTables tables{};
+            constexpr std::size_t slice[4] = {0, 1, 0, 2}; // байт окна -> срез kCrcSlices
+            for (std::size_t k = 1; k < 4; ++k)
+            {
+                for (std::size_t n = 0; n < 16; ++n)
+                {
+                    tables.value[k][0][n] = Crc8<Polynomial>::slices.value[slice[k]][n];
+                    tables.value[k][1][n] = Crc8<Polynomial>::slices.value[slice[k]][n << 4];
+                }
+            }
+            return tables;
+        }
+
+        template <uint8_t Polynomial>
+        struct Syndrome
+        {
+            static constexpr SyndromeTables tables = makeSyndromeTables<Polynomial>();
+        };
+    }
+
+    // Один пакет из канала channel многоканального декодера
+    using ChannelCallback = void (*)(std::size_t channel, const UnpackedPackage &package, void *context);
+
+    // Декодер Channels каналов в одном потоке (шлюз с несколькими фотодиодами).
+    // Состояние хранится по полям (window, prev - массивы по каналам), и за вызов
+    // feed каждый канал продвигается на один переход: 8 (AVX2) или 4 (NEON) канала
+    // за раз, с проверкой CRC через табличные перестановки байт. На x86 без -mavx2
+    // ядро AVX2 включается, если его умеет процессор. Остальные каналы и сборка без
+    // SIMD идут тем же путём, что Decoder (ди-бит и CRC по байтовым таблицам): на
+    // 4 канала SSSE3 этот путь не обгонял, поэтому отдельного ядра SSSE3 нет.
+    // Поддерживается только основной режим (Classic, без segmented/frame_sync/
+    // run_length/FEC) с порогом глитчей; остальное - через Decoder на канал.
+    template <std::size_t Channels, typename Protocol = DefaultProtocol>
+    class MultiDecoder
+    {
+    public:
+        static constexpr std::size_t kMaxWords = Protocol::max_words;
+        static constexpr uint8_t kPolynomial = Protocol::crc_polynomial;
+        static_assert(Channels > 0, "нужен хотя бы один канал");
+        static_assert(kMaxWords > 0 && kMaxWords <= 256, "индекс пакета - один байт");
+
+        explicit MultiDecoder(ChannelCallback callback = nullptr, void *context = nullptr,
+                              long minDuration = Protocol::config.min_duration) noexcept
+            : callback_(callback), context_(context), min_duration_(minDuration), vector_channels_(vectorChannels())
+        {
+            reset();
+        }
+
+        void setCallback(ChannelCallback callback, void *context = nullptr) noexcept
+        {
+            callback_ = callback;
+            context_ = context;
+        }
+
+        // transitions[c] - очередной переход канала c. Канал без нового перехода
+        // передаёт duration = 0: такой переход отбрасывается как глитч.
+        // Возвращает число принятых пакетов.
+        std::size_t feed(const SignalChange *transitions) noexcept
+        {
+            std::size_t found = 0;
+            std::size_t c = 0;
+#if DATAPACK_SIMD_AVX2
+            if (vector_channels_ != 0)
+            {
+                found = feedAvx2(transitions);
+                c = vector_channels_;
+            }
+#elif DATAPACK_SIMD_NEON
+            for (; c + 4 <= Channels; c += 4)
+                found += feed4(transitions + c, c);
+#endif
+            for (; c < Channels; ++c)
+            {
+                const uint32_t level = static_cast<uint32_t>(transitions[c].value);
+                const uint32_t prev = prev_[c];
+                if (transitions[c].duration < min_duration_ || level >= detail::kLevelCount || level == prev)
+                    continue;
+                // getDbit: ранг нового уровня среди четырёх отличных от prev
+                const uint32_t window = (window_[c] << 2) | (level - (level > prev ? 1u : 0u));
+                window_[c] = window;
+                prev_[c] = level;
+                if (crcMatches(window))
+                    found += acceptWindow(c);
+            }
+            return found;
+        }
+
+        const uint16_t *receivedWords(std::size_t channel) const noexcept { return receive_buffer_[channel]; }
+
+        bool isReceived(std::size_t channel, std::size_t index) const noexcept
+        {
+            return index < kMaxWords && (received_[channel][index / 32] >> (index % 32)) & 1u;
+        }
+
+        // Копирует принятые данные канала в data (kMaxWords * 2 байт), возвращает их длину
+        std::size_t getReceivedData(std::size_t channel, uint8_t *data) const noexcept
+        {
+            std::size_t index = 0;
+            for (std::size_t i = 0; i < kMaxWords; ++i)
+            {
+                const uint16_t word = receive_buffer_[channel][i];
+                data[index++] = word & 0xFF;
+                data[index++] = (word >> 8) & 0xFF;
+            }
+            return index;
+        }
+
+        void reset(std::size_t channel) noexcept
+        {
+            window_[channel] = 12345678;
+            prev_[channel] = static_cast<uint32_t>(LightLevel::Off);
+            for (uint16_t &word : receive_buffer_[channel])
+                word = 0;
+            for (uint32_t &bits : received_[channel])
+                bits = 0;
+        }
+
+        void reset() noexcept
+        {
+            for (std::size_t c = 0; c < Channels; ++c)
+                reset(c);
+        }
+
+    private:
+        // Сколько первых каналов идёт через ядро AVX2 (по 8); остаток - скалярно
+        static std::size_t vectorChannels() noexcept
+        {
+#if DATAPACK_SIMD_DISPATCH
+            __builtin_cpu_init();
+            if (!__builtin_cpu_supports("avx2"))
+                return 0;
+#endif
+            return DATAPACK_SIMD_AVX2 ? Channels / 8 * 8 : 0;
+        }
+
+        // Та же проверка, что unpack_and_check: crc против байтов index, data low, data high
+        static bool crcMatches(uint32_t window) noexcept
+        {
+            const detail::CrcSlices &slices = detail::Crc8<kPolynomial>::slices;
+            return static_cast<uint8_t>(window) ==
+                   (slices.value[0][(window >> 16) & 0xFF] ^ slices.value[1][(window >> 8) & 0xFF] ^
+                    slices.value[2][window >> 24]);
+        }
+
+        std::size_t acceptWindow(std::size_t channel) noexcept
+        {
+            // раскладка окна как в unpack_and_check: index, data low, data high, crc
+            const uint32_t window = window_[channel];
+            const uint16_t word = static_cast<uint16_t>(((window >> 16) & 0xFF) | (((window >> 8) & 0xFF) << 8));
+            const UnpackedPackage package = {true, static_cast<uint8_t>(window >> 24), word, 0};
+            if (package.index >= kMaxWords)
+                return 0;
+            receive_buffer_[channel][package.index] = package.word;
+            received_[channel][package.index / 32] |= 1u << (package.index % 32);
+            if (callback_)
+                callback_(channel, package, context_);
+            return 1;
+        }
+
+        // Обработать найденные векторным ядром окна: mask - битовая маска каналов от first
+        std::size_t acceptMask(std::size_t first, unsigned mask) noexcept
+        {
+            std::size_t found = 0;
+            for (; mask != 0; mask &= mask - 1)
+                found += acceptWindow(first + static_cast<std::size_t>(__builtin_ctz(mask)));
+            return found;
+        }
+
+        // Уровень канала для векторного ядра; глитч превращается в недопустимый
+        // уровень и отсекается той же проверкой, что уровни Intensity4
+        int laneLevel(const SignalChange &sc) const noexcept
+        {
+            return sc.duration >= min_duration_ ? static_cast<int>(sc.value) : static_cast<int>(detail::kLevelCount);
+        }
+
+#if DATAPACK_SIMD_AVX2
+        // Все группы по 8 каналов за один вызов: при выборе ядра по процессору
+        // функция с target-атрибутом не встраивается, и вызов на группу дорог
+        DATAPACK_TARGET_AVX2 std::size_t feedAvx2(const SignalChange *transitions) noexcept
+        {
+            std::size_t found = 0;
+            for (std::size_t first = 0; first < vector_channels_; first += 8)
+                found += feed8(transitions + first, first);
+            return found;
+        }
+
+        // Переходы собираются по полям прямо в регистры: через промежуточный массив
+        // векторная загрузка ждала бы скалярных записей (нет store forwarding)
+        DATAPACK_TARGET_AVX2 std::size_t feed8(const SignalChange *tr, std::size_t first) noexcept
+        {
+            const detail::SyndromeTables &t = detail::Syndrome<kPolynomial>::tables;
+            const __m256i level = _mm256_setr_epi32(laneLevel(tr[0]), laneLevel(tr[1]), laneLevel(tr[2]),
+                                                    laneLevel(tr[3]), laneLevel(tr[4]), laneLevel(tr[5]),
+                                                    laneLevel(tr[6]), laneLevel(tr[7]));
+            const __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prev_ + first));
+            const __m256i window = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(window_ + first));
+            // глитч, уровень Intensity4 (> Blue) или повтор уровня - канал стоит на месте
+            __m256i active = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(detail::kLevelCount)), level);
+            active = _mm256_andnot_si256(_mm256_cmpeq_epi32(level, prev), active);
+
+            // level - (level > prev): сравнение даёт -1 там, где нужно вычесть единицу
+            const __m256i dbit = _mm256_add_epi32(level, _mm256_cmpgt_epi32(level, prev));
+            const __m256i shifted = _mm256_or_si256(_mm256_slli_epi32(window, 2), dbit);
+            const __m256i next = _mm256_blendv_epi8(window, shifted, active);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(window_ + first), next);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(prev_ + first), _mm256_blendv_epi8(prev, level, active));
+
+            const __m256i nibble = _mm256_set1_epi8(0x0F);
+            const __m256i lo = _mm256_and_si256(next, nibble);
+            const __m256i hi = _mm256_and_si256(_mm256_srli_epi32(next, 4), nibble);
+            __m256i value = _mm256_and_si256(next, _mm256_set1_epi32(0xFF));
+            for (std::size_t k = 1; k < 4; ++k)
+            {
+                const __m256i tableLo = _mm256_broadcastsi128_si256(
+                    _mm_load_si128(reinterpret_cast<const __m128i *>(t.value[k][0])));
+                const __m256i tableHi = _mm256_broadcastsi128_si256(
+                    _mm_load_si128(reinterpret_cast<const __m128i *>(t.value[k][1])));
+                const __m256i part = _mm256_xor_si256(_mm256_shuffle_epi8(tableLo, lo), _mm256_shuffle_epi8(tableHi, hi));
+                value = _mm256_xor_si256(value, _mm256_and_si256(part, _mm256_set1_epi32(static_cast<int>(0xFFu << (8 * k)))));
+            }
+            value = _mm256_xor_si256(value, _mm256_srli_epi32(value, 16));
+            value = _mm256_xor_si256(value, _mm256_srli_epi32(value, 8));
+            value = _mm256_and_si256(value, _mm256_set1_epi32(0xFF));
+            const __m256i valid = _mm256_and_si256(_mm256_cmpeq_epi32(value, _mm256_setzero_si256()), active);
+            const unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(valid)));
+            return mask ? acceptMask(first, mask) : 0;
+        }
+#endif
+
+#if DATAPACK_SIMD_NEON
+        std::size_t feed4(const SignalChange *tr, std::size_t first) noexcept
+        {
+            const detail::SyndromeTables &t = detail::Syndrome<kPolynomial>::tables;
+            uint32x4_t level = vdupq_n_u32(static_cast<uint32_t>(laneLevel(tr[0])));
+            level = vsetq_lane_u32(static_cast<uint32_t>(laneLevel(tr[1])), level, 1);
+            level = vsetq_lane_u32(static_cast<uint32_t>(laneLevel(tr[2])), level, 2);
+            level = vsetq_lane_u32(static_cast<uint32_t>(laneLevel(tr[3])), level, 3);
+            const uint32x4_t prev = vld1q_u32(prev_ + first);
+            const uint32x4_t window = vld1q_u32(window_ + first);
+            const uint32x4_t active =
+                vbicq_u32(vcltq_u32(level, vdupq_n_u32(static_cast<uint32_t>(detail::kLevelCount))), vceqq_u32(level, prev));
+
+            const uint32x4_t dbit = vaddq_u32(level, vcgtq_u32(level, prev));
+            const uint32x4_t next = vbslq_u32(active, vorrq_u32(vshlq_n_u32(window, 2), dbit), window);
+            vst1q_u32(window_ + first, next);
+            vst1q_u32(prev_ + first, vbslq_u32(active, level, prev));
+
+            const uint8x16_t bytes = vreinterpretq_u8_u32(next);
+            const uint8x16_t lo = vandq_u8(bytes, vdupq_n_u8(0x0F));
+            const uint8x16_t hi = vshrq_n_u8(bytes, 4);
+            uint32x4_t value = vandq_u32(next, vdupq_n_u32(0xFF));
+            for (std::size_t k = 1; k < 4; ++k)
+            {
+                const uint8x16_t part = veorq_u8(vqtbl1q_u8(vld1q_u8(t.value[k][0]), lo),
+                                                 vqtbl1q_u8(vld1q_u8(t.value[k][1]), hi));
+                value = veorq_u32(value, vandq_u32(vreinterpretq_u32_u8(part), vdupq_n_u32(0xFFu << (8 * k))));
+            }
+            value = veorq_u32(value, vshrq_n_u32(value, 16));
+            value = veorq_u32(value, vshrq_n_u32(value, 8));
+            value = vandq_u32(value, vdupq_n_u32(0xFF));
+            const uint32x4_t valid = vandq_u32(vceqq_u32(value, vdupq_n_u32(0)), active);
+            if (vmaxvq_u32(valid) == 0)
+                return 0;
+            uint32_t lanes[4];
+            vst1q_u32(lanes, valid);
+            unsigned mask = 0;
+            for (unsigned lane = 0; lane < 4; ++lane)
+                mask |= lanes[lane] ? 1u << lane : 0u;
+            return acceptMask(first, mask);
+        }
+#endif
+
+        ChannelCallback callback_;
+        void *context_;
+        long min_duration_;
+        std::size_t vector_channels_; // каналы [0, vector_channels_) идут через ядро AVX2
+        uint32_t window_[Channels];
+        uint32_t prev_[Channels];
+        uint16_t receive_buffer_[Channels][kMaxWords];
+        uint32_t received_[Channels][(kMaxWords + 31) / 32];
+    };
+
+    /*
+        Глобальный API: один кодер и один декодер на программу.
+        Оставлен для совместимости; новый код должен использовать Encoder/Decoder.
+    */
+
+    inline int min_duration = 60; // порог игнора
+    inline int duration = 125;    // продолжительность каждого сигнала
+
+    inline SignalBuffer send_commands;
+    inline WordBuffer send_buffer;
+    inline void (*onPacketReceived)(UnpackedPackage) = nullptr;
+
+    namespace detail
+    {
+        inline void forwardToGlobalCallback(const UnpackedPackage &package, void *)
+        {
+            if (onPacketReceived)
+                onPacketReceived(package);
+        }
+
+        inline Decoder global_decoder{forwardToGlobalCallback};
+        inline TraceRing *global_trace = nullptr;
+        inline TraceClock global_trace_clock = nullptr;
+
+        struct LegacyGlobals
+        {
+            static uint16_t (&receiveBuffer(Decoder &decoder) noexcept)[kMaxWords] { return decoder.receive_buffer_; }
+            static uint32_t &window(Decoder &decoder) noexcept { return decoder.window_; }
+            static LightLevel &prevValue(Decoder &decoder) noexcept { return decoder.prev_value_; }
+        };
+    }
+
+    // Состояние общего декодера под прежними именами. feed держит окно и уровень
+    // в локальных переменных и возвращает их по выходе, так что между вызовами
+    // значения действительны, а запись в них действует на следующий feed.
+    inline uint16_t (&receive_buffer)[kMaxWords] = detail::LegacyGlobals::receiveBuffer(detail::global_decoder);
+    inline uint32_t &window = detail::LegacyGlobals::window(detail::global_decoder);
+    inline LightLevel &prev_value = detail::LegacyGlobals::prevValue(detail::global_decoder);
+
+    // Трасса глобальных encode и feed (см. BasicDecoder::setTrace); nullptr отключает
+    inline void setTrace(TraceRing *ring, TraceClock clock)
+    {
+        detail::global_trace = ring;
+        detail::global_trace_clock = clock;
+        detail::global_decoder.setTrace(ring, clock);
+    }
+
+    inline void encode()
+    {
+        detail::trace(detail::global_trace, detail::global_trace_clock, TraceEvent::EncodeBegin,
+                      static_cast<long>(send_buffer.size() * 2), 0);
+        Encoder({min_duration, duration}).encodeWords(send_buffer.data(), send_buffer.size(), send_commands);
+        detail::trace(detail::global_trace, detail::global_trace_clock, TraceEvent::EncodeEnd,
+                      static_cast<long>(send_commands.size()), 0);
+    }
+
+    inline void setSendData(const uint8_t *data, size_t len)
+    {
+        if (len > send_buffer.capacity() * 2)
+            len = send_buffer.capacity() * 2;
+        packWords(data, len, send_buffer);
+        encode();
+    }
+
+    // Меняет len байт данных начиная с offset и перекодирует только затронутые
+    // пакеты send_commands. Данные за пределами текущего сообщения отбрасываются;
+    // после смены duration сначала нужен encode().
+    inline void updateSendData(size_t offset, const uint8_t *data, size_t len)
+    {
+        const size_t bytes = send_buffer.size() * 2;
+        if (offset >= bytes)
+            return;
+        if (len > bytes - offset)
+            len = bytes - offset;
+        for (size_t i = 0; i < len; ++i)
+        {
+            uint16_t &word = send_buffer[(offset + i) / 2];
+            word = (offset + i) % 2 == 0 ? static_cast<uint16_t>((word & 0xFF00) | data[i])
+                                         : static_cast<uint16_t>((word & 0x00FF) | (data[i] << 8));
+        }
+        const size_t first = offset / 2;
+        Encoder({min_duration, duration})
+            .updateWords(send_buffer.data(), send_buffer.size(), first, (offset + len + 1) / 2 - first, send_commands);
+    }
+
+    inline size_t getReceivedData(uint8_t *data)
+    {
+        return detail::global_decoder.getReceivedData(data);
+    }
+
+    inline void feed(SignalChange sc)
+    {
+        detail::global_decoder.setConfig({min_duration, duration});
+        detail::global_decoder.feed(sc);
+    }
+
+    inline size_t feed(const SignalChange *signals, size_t count)
+    {
+        detail::global_decoder.setConfig({min_duration, duration});
+        return detail::global_decoder.feed(signals, count);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,155 @@
+#include "datapacklib_c.h"
+
+#include "datapacklib.h"
+
+#include <new>
+
+// Реализация C ABI из datapacklib_c.h поверх Encoder и Decoder
+
+static_assert(sizeof(datapack_config) == 12, "раскладка datapack_config входит в ABI");
+
+struct datapack_encoder
+{
+    datapack::Encoder encoder;
+    datapack::Encoder::Signals signals;
+};
+
+struct datapack_decoder
+{
+    datapack::Decoder decoder;
+};
+
+namespace
+{
+    datapack::ProtocolConfig toConfig(const datapack_config *config)
+    {
+        datapack::ProtocolConfig result;
+        if (!config)
+            return result;
+        result.min_duration = config->min_duration;
+        result.duration = config->duration;
+        result.modulation =
+            config->modulation == 1 ? datapack::Modulation::Intensity4 : datapack::Modulation::Classic;
+        result.segmented = config->flags & DATAPACK_SEGMENTED;
+        result.frame_sync = config->flags & DATAPACK_FRAME_SYNC;
+        result.run_length = config->flags & DATAPACK_RUN_LENGTH;
+        result.length_packet = config->flags & DATAPACK_LENGTH_PACKET;
+        result.clock_recovery = config->flags & DATAPACK_CLOCK_RECOVERY;
+        result.fec_group = config->fec_group;
+        result.fec_depth = config->fec_depth;
+        return result;
+    }
+}
+
+uint32_t datapack_abi_version(void) { return DATAPACK_C_ABI_VERSION; }
+
+void datapack_config_default(datapack_config *config)
+{
+    const datapack::ProtocolConfig defaults;
+    config->min_duration = static_cast<int32_t>(defaults.min_duration);
+    config->duration = static_cast<int32_t>(defaults.duration);
+    config->modulation = static_cast<uint8_t>(defaults.modulation);
+    config->flags = 0;
+    config->fec_group = defaults.fec_group;
+    config->fec_depth = defaults.fec_depth;
+}
+
+size_t datapack_max_transitions(void) { return datapack::Encoder::Signals().capacity(); }
+
+size_t datapack_max_message(void) { return datapack::kMaxWords * 2; }
+
+datapack_encoder *datapack_encoder_create(const datapack_config *config)
+{
+    datapack_encoder *encoder = new (std::nothrow) datapack_encoder;
+    if (encoder)
+        encoder->encoder.setConfig(toConfig(config));
+    return encoder;
+}
+
+void datapack_encoder_destroy(datapack_encoder *encoder) { delete encoder; }
+
+void datapack_encoder_set_config(datapack_encoder *encoder, const datapack_config *config)
+{
+    encoder->encoder.setConfig(toConfig(config));
+}
+
+size_t datapack_encode(datapack_encoder *encoder, const uint8_t *data, size_t len, int32_t *transitions,
+                       size_t max_transitions)
+{
+    if (!encoder->encoder.encode(data, len, encoder->signals) || encoder->signals.size() > max_transitions)
+        return 0;
+    for (std::size_t i = 0; i < encoder->signals.size(); ++i)
+    {
+        transitions[2 * i] = static_cast<int32_t>(encoder->signals[i].value);
+        transitions[2 * i + 1] = static_cast<int32_t>(encoder->signals[i].duration);
+    }
+    return encoder->signals.size();
+}
+
+datapack_decoder *datapack_decoder_create(const datapack_config *config)
+{
+    datapack_decoder *decoder = new (std::nothrow) datapack_decoder;
+    if (decoder)
+        decoder->decoder.setConfig(toConfig(config));
+    return decoder;
+}
+
+void datapack_decoder_destroy(datapack_decoder *decoder) { delete decoder; }
+
+void datapack_decoder_set_config(datapack_decoder *decoder, const datapack_config *config)
+{
+    decoder->decoder.setConfig(toConfig(config));
+}
+
+void datapack_decoder_reset(datapack_decoder *decoder) { decoder->decoder.reset(); }
+
+size_t datapack_decoder_feed(datapack_decoder *decoder, const int32_t *transitions, size_t count,
+                             uint32_t *packets, size_t max_packets)
+{
+    // пары разворачиваются в SignalChange пачками, которые остаются в кэше
+    constexpr std::size_t kBlock = 256;
+    datapack::SignalChange block[kBlock];
+    datapack::UnpackedPackage found[kBlock];
+    std::size_t total = 0;
+    for (std::size_t first = 0; first < count; first += kBlock)
+    {
+        const std::size_t n = count - first < kBlock ? count - first : kBlock;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            block[i].value = static_cast<datapack::LightLevel>(transitions[2 * (first + i)]);
+            block[i].duration = transitions[2 * (first + i) + 1];
+        }
+        // в пачке из kBlock переходов не больше kBlock пакетов
+        const std::size_t got = decoder->decoder.feed(block, n, found, kBlock);
+        for (std::size_t k = 0; k < got; ++k, ++total)
+        {
+            if (total < max_packets)
+                packets[total] = static_cast<uint32_t>(found[k].segment) << 24 |
+                                 static_cast<uint32_t>(found[k].index) << 16 | found[k].word;
+        }
+    }
+    return total;
+}
+
+size_t datapack_decoder_received_data(const datapack_decoder *decoder, uint8_t *data, size_t max_len)
+{
+    return decoder->decoder.getReceivedData(data, max_len);
+}
+
+void datapack_decoder_received_words(const datapack_decoder *decoder, uint16_t *words)
+{
+    const uint16_t *received = decoder->decoder.receivedWords();
+    for (std::size_t i = 0; i < datapack::kMaxWords; ++i)
+        words[i] = received[i];
+}
+
+int datapack_decoder_is_received(const datapack_decoder *decoder, size_t index)
+{
+    return decoder->decoder.isReceived(index);
+}
+
+size_t datapack_decoder_received_count(const datapack_decoder *decoder) { return decoder->decoder.receivedCount(); }
+
+int datapack_decoder_complete(const datapack_decoder *decoder) { return decoder->decoder.complete(); }
+
+size_t datapack_decoder_message_length(const datapack_decoder *decoder) { return decoder->decoder.messageLength(); }
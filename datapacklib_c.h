@@ -0,0 +1,108 @@
+/**
+ * @file datapacklib_c.h
+ * @brief Stable C ABI over the datapack encoder and decoder (FFI, WebAssembly).
+ */
+
+#ifndef DATAPACKLIB_C_H
+#define DATAPACKLIB_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Тонкая обёртка над Encoder/Decoder для кода не на C++: FFI, Python ctypes,
+    WebAssembly (см. datapacklib_wasm.js). Реализация - datapacklib_c.cpp.
+
+    Переходы передаются массивами int32_t парами (уровень, длительность), пакеты -
+    uint32_t вида segment << 24 | index << 16 | word. Так пачка переходов или
+    пакетов пересекает границу языка одним куском памяти.
+
+    Раскладка структур и значения констант не меняются в пределах одной
+    DATAPACK_C_ABI_VERSION.
+*/
+
+#define DATAPACK_C_ABI_VERSION 1
+
+#if defined(__EMSCRIPTEN__)
+#include <emscripten/emscripten.h>
+#define DATAPACK_C_API EMSCRIPTEN_KEEPALIVE
+#elif defined(_WIN32)
+#define DATAPACK_C_API
+#else
+#define DATAPACK_C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* Флаги datapack_config::flags - режимы ProtocolConfig */
+    enum
+    {
+        DATAPACK_SEGMENTED = 1,
+        DATAPACK_FRAME_SYNC = 2,
+        DATAPACK_RUN_LENGTH = 4,
+        DATAPACK_LENGTH_PACKET = 8,
+        DATAPACK_CLOCK_RECOVERY = 16
+    };
+
+    /* ProtocolConfig; 12 байт: 0 min_duration, 4 duration, 8 modulation, 9 flags, 10 fec_group, 11 fec_depth */
+    typedef struct datapack_config
+    {
+        int32_t min_duration;
+        int32_t duration;
+        uint8_t modulation; /* 0 - Classic, 1 - Intensity4 */
+        uint8_t flags;
+        uint8_t fec_group;
+        uint8_t fec_depth;
+    } datapack_config;
+
+    typedef struct datapack_encoder datapack_encoder;
+    typedef struct datapack_decoder datapack_decoder;
+
+    DATAPACK_C_API uint32_t datapack_abi_version(void);
+
+    DATAPACK_C_API void datapack_config_default(datapack_config *config);
+
+    /* Сколько переходов (пар) может дать одно сообщение и сколько в нём байт */
+    DATAPACK_C_API size_t datapack_max_transitions(void);
+    DATAPACK_C_API size_t datapack_max_message(void);
+
+    /* config == NULL - настройки по умолчанию; NULL при нехватке памяти */
+    DATAPACK_C_API datapack_encoder *datapack_encoder_create(const datapack_config *config);
+    DATAPACK_C_API void datapack_encoder_destroy(datapack_encoder *encoder);
+    DATAPACK_C_API void datapack_encoder_set_config(datapack_encoder *encoder, const datapack_config *config);
+
+    /* Кодирует len байт в transitions (max_transitions пар). Возвращает число пар;
+       0 - данные не помещаются в сообщение или в transitions. */
+    DATAPACK_C_API size_t datapack_encode(datapack_encoder *encoder, const uint8_t *data, size_t len,
+                                          int32_t *transitions, size_t max_transitions);
+
+    DATAPACK_C_API datapack_decoder *datapack_decoder_create(const datapack_config *config);
+    DATAPACK_C_API void datapack_decoder_destroy(datapack_decoder *decoder);
+    DATAPACK_C_API void datapack_decoder_set_config(datapack_decoder *decoder, const datapack_config *config);
+    DATAPACK_C_API void datapack_decoder_reset(datapack_decoder *decoder);
+
+    /* Декодирует count пар из transitions. Найденные пакеты (не больше max_packets)
+       пишутся в packets; возвращает их общее число. */
+    DATAPACK_C_API size_t datapack_decoder_feed(datapack_decoder *decoder, const int32_t *transitions, size_t count,
+                                                uint32_t *packets, size_t max_packets);
+
+    /* Достоверные данные (всё сообщение или принятый без пропусков префикс), не больше max_len байт */
+    DATAPACK_C_API size_t datapack_decoder_received_data(const datapack_decoder *decoder, uint8_t *data,
+                                                         size_t max_len);
+
+    /* Весь буфер приёма как есть: datapack_max_message() / 2 слов */
+    DATAPACK_C_API void datapack_decoder_received_words(const datapack_decoder *decoder, uint16_t *words);
+
+    DATAPACK_C_API int datapack_decoder_is_received(const datapack_decoder *decoder, size_t index);
+    DATAPACK_C_API size_t datapack_decoder_received_count(const datapack_decoder *decoder);
+    DATAPACK_C_API int datapack_decoder_complete(const datapack_decoder *decoder);
+    DATAPACK_C_API size_t datapack_decoder_message_length(const datapack_decoder *decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1202 @@
+/**
+ * @file datapacklib_host.h
+ * @brief Host-side tools on top of datapacklib.h: offline trace decoding, a channel simulator, trace dumps,
+ *        capture files, a threaded transmitter and coroutine pipeline stages.
+ */
+
+#pragma once
+
+#include "datapacklib.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DATAPACK_HAS_MMAP 1
+#else
+#define DATAPACK_HAS_MMAP 0
+#endif
+
+#if defined(__linux__)
+#include <errno.h>
+#include <time.h>
+#define DATAPACK_HAS_CLOCK_NANOSLEEP 1
+#else
+#define DATAPACK_HAS_CLOCK_NANOSLEEP 0
+#endif
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#include <exception>
+#define DATAPACK_HAS_COROUTINES 1
+#else
+#define DATAPACK_HAS_COROUTINES 0
+#endif
+
+/*
+    Всё, что здесь есть, рассчитано на рабочую станцию или шлюз: потоки и
+    динамическая память. На метках достаточно datapacklib.h.
+*/
+
+namespace datapack
+{
+    // Пакет из записанной трассы: position - номер перехода, на котором декодер его выдал
+    struct TracePacket
+    {
+        std::size_t position;
+        UnpackedPackage package;
+    };
+
+    // Сколько пакетов перед началом куска декодер прогоняет вхолостую. Состояние
+    // основного режима сходится за 17 переходов (один на prev, 16 на окно),
+    // frame_sync нужно ещё два пакета на захват, clock_recovery - время на оценку тика.
+    constexpr std::size_t kTraceWarmupPackets = 8;
+
+    // Последовательное декодирование трассы: результат, с которым сверяется decodeTrace
+    template <typename Protocol = DefaultProtocol>
+    inline void decodeTraceRange(const SignalChange *trace, std::size_t begin, std::size_t end, std::size_t owned,
+                                 const ProtocolConfig &config, std::vector<TracePacket> &out)
+    {
+        constexpr std::size_t kBlock = 1024;
+        BasicDecoder<Protocol> decoder(nullptr, nullptr, config);
+        UnpackedPackage packets[kBlock];
+        std::size_t positions[kBlock];
+        for (std::size_t first = begin; first < end; first += kBlock)
+        {
+            const std::size_t count = end - first < kBlock ? end - first : kBlock;
+            // в пачке из kBlock переходов не больше kBlock пакетов, переполнения нет
+            const std::size_t found = decoder.feed(trace + first, count, packets, kBlock, positions);
+            for (std::size_t k = 0; k < found; ++k)
+            {
+                const std::size_t position = first + positions[k];
+                // пакеты разгона принадлежат предыдущему куску
+                if (position >= owned)
+                    out.push_back({position, packets[k]});
+            }
+        }
+    }
+
+    // Декодирует трассу из count переходов в threads потоков (0 - по числу ядер) и
+    // возвращает пакеты в порядке трассы, как при последовательном feed. Каждый
+    // кусок начинается с разгона на kTraceWarmupPackets пакетов из предыдущего, а
+    // пакет достаётся тому куску, в чьей части он выдан, поэтому повторов на стыках нет.
+    // Номер сегмента (segmented) зависит от всей предыстории - такие трассы
+    // декодируются в одном потоке. С clock_recovery оценка тика в каждом куске
+    // начинается заново, и у стыков изредка возможны расхождения в отдельных пакетах.
+    template <typename Protocol = DefaultProtocol>
+    inline std::vector<TracePacket> decodeTrace(const SignalChange *trace, std::size_t count,
+                                                const ProtocolConfig &config = Protocol::config, unsigned threads = 0)
+    {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        const std::size_t warmup = kTraceWarmupPackets * symbolsPerPacket(config);
+        // куски короче нескольких разгонов параллелить нет смысла
+        std::size_t chunks = threads == 0 ? 1 : threads;
+        if (config.segmented || count < chunks * warmup * 16)
+            chunks = 1;
+
+        std::vector<std::vector<TracePacket>> results(chunks);
+        std::vector<std::thread> workers;
+        workers.reserve(chunks);
+        for (std::size_t k = 0; k < chunks; ++k)
+        {
+            const std::size_t owned = count / chunks * k;
+            const std::size_t end = k + 1 == chunks ? count : count / chunks * (k + 1);
+            // разгон считается в переходах, которые пройдут порог глитчей
+            std::size_t begin = owned;
+            for (std::size_t seen = 0; begin > 0 && seen < warmup; --begin)
+            {
+                if (trace[begin - 1].duration >= config.min_duration)
+                    ++seen;
+            }
+            workers.emplace_back([=, &results] {
+                decodeTraceRange<Protocol>(trace, begin, end, owned, config, results[k]);
+            });
+        }
+
+        std::vector<TracePacket> packets;
+        for (std::size_t k = 0; k < chunks; ++k)
+        {
+            workers[k].join();
+            packets.insert(packets.end(), results[k].begin(), results[k].end());
+        }
+        return packets;
+    }
+}
+
+namespace datapack
+{
+    // Искажения канала. Вероятности - на переход, доли длительности - от 0 до 1.
+    struct ChannelParams
+    {
+        double drop = 0;         // переход потерян: предыдущий уровень держится дольше
+        double duplicate = 0;    // уровень разбит на два одинаковых перехода
+        double glitch = 0;       // перед переходом вставлен импульс случайного цвета
+        long glitch_duration = 20; // длительность такого импульса (меньше min_duration)
+        double confusion = 0;    // цвет принят как другой случайный
+        double jitter = 0;       // длительность умножается на 1 +- jitter (равномерно)
+        double skew = 0;         // тик передатчика длиннее номинала на эту долю
+        double drift = 0;        // skew меняется на столько за переход
+        uint64_t seed = 1;
+        // алфавит, из которого берутся перепутанные цвета и помехи (simulateLink берёт его из config)
+        Modulation modulation = Modulation::Classic;
+    };
+
+    // Модель канала между кодером и декодером. Детерминирована: одинаковые seed и
+    // вход дают одинаковый выход. Не выделяет памяти и пишет в sink по одному
+    // переходу, поэтому годится для прогонов на миллионы пакетов.
+    class ChannelModel
+    {
+    public:
+        explicit ChannelModel(const ChannelParams &params = ChannelParams()) noexcept { reset(params); }
+
+        void reset(const ChannelParams &params) noexcept
+        {
+            params_ = params;
+            state_ = params.seed;
+            skew_ = params.skew;
+            has_pending_ = false;
+        }
+
+        // Пропускает count переходов через канал. Последний переход задерживается
+        // до следующего вызова (его может удлинить потеря) - в конце нужен flush.
+        template <typename Sink>
+        void transmit(const SignalChange *signals, std::size_t count, Sink &&sink)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                SignalChange sc = signals[i];
+                const double stretch = (1 + skew_) * (1 + params_.jitter * (2 * uniform() - 1));
+                skew_ += params_.drift;
+                sc.duration = static_cast<long>(sc.duration * stretch + 0.5);
+
+                if (has_pending_ && chance(params_.drop))
+                {
+                    pending_.duration += sc.duration;
+                    continue;
+                }
+                if (chance(params_.confusion))
+                    sc.value = otherLevel(sc.value);
+                if (chance(params_.glitch))
+                {
+                    emit(sink, {otherLevel(has_pending_ ? pending_.value : sc.value), params_.glitch_duration});
+                }
+                if (chance(params_.duplicate))
+                {
+                    const long half = sc.duration / 2;
+                    emit(sink, {sc.value, half});
+                    sc.duration -= half;
+                }
+                emit(sink, sc);
+            }
+        }
+
+        template <typename Sink>
+        void flush(Sink &&sink)
+        {
+            if (has_pending_)
+                detail::emit(sink, pending_);
+            has_pending_ = false;
+        }
+
+    private:
+        template <typename Sink>
+        void emit(Sink &sink, const SignalChange &sc)
+        {
+            if (has_pending_)
+                detail::emit(sink, pending_);
+            pending_ = sc;
+            has_pending_ = true;
+        }
+
+        // splitmix64: быстрее std::mt19937 и не зависит от реализации стандартной библиотеки
+        uint64_t next() noexcept
+        {
+            uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        double uniform() noexcept { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+        bool chance(double probability) noexcept { return probability > 0 && uniform() < probability; }
+
+        // Classic - любой другой из 5 уровней. Intensity4 путает соседей: тот же цвет на
+        // соседней ступени яркости или другой цвет на той же ступени; самая тусклая
+        // ступень соседствует с Off.
+        LightLevel otherLevel(LightLevel level) noexcept
+        {
+            if (params_.modulation != Modulation::Intensity4)
+            {
+                const uint64_t shift = 1 + next() % (detail::kLevelCount - 1);
+                return static_cast<LightLevel>((static_cast<uint64_t>(level) + shift) % detail::kLevelCount);
+            }
+            constexpr uint8_t kDimmest = kIntensitySteps - 1;
+            LightLevel candidates[5];
+            std::size_t count = 0;
+            if (level == LightLevel::Off || static_cast<std::size_t>(level) >= kIntensityLevelCount)
+            {
+                for (int colour = 1; colour <= 4; ++colour)
+                    candidates[count++] = makeLevel(static_cast<LightLevel>(colour), kDimmest);
+            }
+            else
+            {
+                const LightLevel colour = baseColour(level);
+                const uint8_t step = intensityStep(level);
+                for (int other = 1; other <= 4; ++other)
+                {
+                    if (static_cast<LightLevel>(other) != colour)
+                        candidates[count++] = makeLevel(static_cast<LightLevel>(other), step);
+                }
+                if (step > 0)
+                    candidates[count++] = makeLevel(colour, static_cast<uint8_t>(step - 1));
+                candidates[count++] = step < kDimmest ? makeLevel(colour, static_cast<uint8_t>(step + 1)) : LightLevel::Off;
+            }
+            return candidates[next() % count];
+        }
+
+        ChannelParams params_;
+        uint64_t state_;
+        double skew_;
+        SignalChange pending_;
+        bool has_pending_;
+    };
+
+    // Итог прогона simulateLink
+    struct LinkStats
+    {
+        std::size_t messages = 0;
+        std::size_t intact = 0;       // сообщений принято целиком и без ошибок
+        std::size_t words = 0;        // слов данных отправлено
+        std::size_t words_ok = 0;     // слов вернулось без ошибок
+        std::size_t words_wrong = 0;  // слов вернулось с ошибкой (ложная CRC)
+        std::size_t air_time = 0;     // суммарная длительность переданных символов
+
+        // байт полезных данных на единицу длительности, с учётом потерянных сообщений
+        double goodput(std::size_t len) const noexcept
+        {
+            return air_time ? static_cast<double>(intact * len) / static_cast<double>(air_time) : 0.0;
+        }
+    };
+
+    // Монте-Карло прогон: messages сообщений по len байт через канал. Декодер
+    // сбрасывается перед каждым сообщением, между сообщениями - пауза в уровне Off.
+    template <typename Protocol = DefaultProtocol>
+    inline LinkStats simulateLink(const ProtocolConfig &config, const ChannelParams &channel, std::size_t messages,
+                                  std::size_t len)
+    {
+        LinkStats stats;
+        ChannelParams params = channel;
+        params.modulation = config.modulation;
+        ChannelModel model(params);
+        BasicEncoder<Protocol> encoder(config);
+        BasicDecoder<Protocol> decoder(nullptr, nullptr, config);
+        typename BasicEncoder<Protocol>::Signals out;
+        uint8_t data[Protocol::max_words * 2];
+        uint8_t received[Protocol::max_words * 2];
+        uint64_t fill = channel.seed;
+        if (len > sizeof(data))
+            len = sizeof(data);
+
+        for (std::size_t m = 0; m < messages; ++m)
+        {
+            for (std::size_t i = 0; i < len; ++i)
+            {
+                fill = fill * 6364136223846793005ull + 1442695040888963407ull;
+                data[i] = static_cast<uint8_t>(fill >> 56);
+            }
+            if (!encoder.encode(data, len, out))
+                break;
+            decoder.reset();
+            const SignalChange gap{LightLevel::Off, config.duration};
+            // переходы копятся в пачку для bulk feed
+            SignalChange batch[256];
+            std::size_t batched = 0;
+            auto sink = [&](const SignalChange &sc) {
+                stats.air_time += static_cast<std::size_t>(sc.duration);
+                batch[batched++] = sc;
+                if (batched == 256)
+                {
+                    decoder.feed(batch, batched);
+                    batched = 0;
+                }
+            };
+            model.transmit(&gap, 1, sink);
+            model.transmit(out.data(), out.size(), sink);
+            model.flush(sink);
+            decoder.feed(batch, batched);
+
+            // с FEC слова данных - не то же, что слова в эфире: сравниваем восстановленные
+            const std::size_t got = decoder.getReceivedData(received);
+            const std::size_t dataWords = (len + 1) / 2;
+            bool intact = got >= len;
+            for (std::size_t w = 0; w < dataWords; ++w)
+            {
+                const bool present = decoder.isRecoverable(w);
+                const bool equal = received[2 * w] == data[2 * w] &&
+                                   (2 * w + 1 == len || received[2 * w + 1] == data[2 * w + 1]);
+                stats.words_ok += present && equal;
+                stats.words_wrong += present && !equal;
+                intact = intact && present && equal;
+            }
+            stats.words += dataWords;
+            stats.intact += intact;
+            ++stats.messages;
+        }
+        return stats;
+    }
+}
+
+namespace datapack
+{
+    // Разбирает дамп dumpTrace (size байт) обратно в записи; хвост неполной записи отбрасывается
+    inline std::vector<TraceRecord> parseTrace(const void *data, std::size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        std::vector<TraceRecord> records(size / kTraceRecordSize);
+        for (TraceRecord &record : records)
+        {
+            uint32_t fields[3];
+            for (uint32_t &field : fields)
+            {
+                field = static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+                        static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+                bytes += 4;
+            }
+            record.timestamp = fields[0];
+            record.duration = static_cast<int32_t>(fields[1]);
+            record.window = fields[2];
+            record.event = bytes[0];
+            record.level = bytes[1];
+            record.crc = bytes[2];
+            record.reserved = bytes[3];
+            bytes += 4;
+        }
+        return records;
+    }
+
+    // Печатает трассу по строке на событие: отметка, приращение к предыдущей
+    // записи, событие и его поля. У Packet дописана задержка от последнего
+    // перехода - то, сколько пакет шёл от входа в feed до коллбэка.
+    inline void printTrace(const std::vector<TraceRecord> &records, std::ostream &out)
+    {
+        static const char *const events[] = {"symbol", "filtered", "packet", "encode+", "encode-"};
+        static const char *const levels[] = {"Off", "White", "Red", "Green", "Blue"};
+        static const char *const checks[] = {"-", "fail", "pass", "meta"};
+        const std::ios_base::fmtflags flags = out.flags();
+        uint32_t previous = records.empty() ? 0 : records.front().timestamp;
+        uint32_t lastSymbol = previous;
+        for (const TraceRecord &record : records)
+        {
+            out << std::dec << std::setw(10) << record.timestamp << " +" << std::left << std::setw(8)
+                << static_cast<uint32_t>(record.timestamp - previous) << std::setw(9)
+                << (record.event < 5 ? events[record.event] : "?") << std::right;
+            previous = record.timestamp;
+            switch (static_cast<TraceEvent>(record.event))
+            {
+            case TraceEvent::Symbol:
+            case TraceEvent::Filtered:
+                lastSymbol = record.timestamp;
+                out << std::left << std::setw(6) << (record.level < 5 ? levels[record.level] : "?") << std::right
+                    << std::setw(7) << record.duration << "  window " << std::hex << std::setfill('0') << std::setw(8)
+                    << record.window << std::setfill(' ') << std::dec << "  crc "
+                    << (record.crc < 4 ? checks[record.crc] : "?");
+                break;
+            case TraceEvent::Packet:
+                out << "segment " << (record.window >> 24) << " index " << ((record.window >> 16) & 0xFF) << " word 0x"
+                    << std::hex << std::setfill('0') << std::setw(4) << (record.window & 0xFFFF) << std::setfill(' ')
+                    << std::dec << "  latency " << static_cast<uint32_t>(record.timestamp - lastSymbol);
+                break;
+            case TraceEvent::EncodeBegin:
+                out << record.duration << " bytes";
+                break;
+            case TraceEvent::EncodeEnd:
+                out << record.duration << " symbols";
+                break;
+            }
+            out << '\n';
+        }
+        out.flags(flags);
+    }
+}
+
+namespace datapack
+{
+    /*
+        Файл записи переходов (capture). Все поля little-endian.
+
+        Заголовок, kCaptureHeaderSize байт:
+        0   4 байта - магия "DPC1"
+        4   uint16  - версия формата (kCaptureVersion)
+        6   uint8   - формат записей (CaptureFormat)
+        7   uint8   - модуляция (Modulation)
+        8   uint32  - тик для Packed16 (у Raw32 не используется)
+        12  int32   - min_duration
+        16  int32   - duration
+        20  uint8   - флаги: 1 segmented, 2 frame_sync, 4 run_length, 8 length_packet, 16 clock_recovery
+        21  uint8   - fec_group
+        22  uint8   - fec_depth
+        23  uint8   - резерв
+        24  uint64  - число записей
+
+        Дальше записи подряд:
+        Raw32    - uint32: длительность << 5 | уровень, длительность до 2^27 - 1 без потерь
+        Packed16 - uint16 как в PackedSignalBuffer: тики << 5 | уровень. Длительность
+                   округляется до тика, но не через min_duration из заголовка: декодер
+                   отбрасывает те же переходы, что в Raw32. Отклонение тика меньше
+                   тика теряется - для разбора с clock_recovery нужен Raw32.
+    */
+    enum class CaptureFormat : uint8_t
+    {
+        Raw32 = 0,
+        Packed16 = 1
+    };
+
+    constexpr std::size_t kCaptureHeaderSize = 32;
+    constexpr uint16_t kCaptureVersion = 1;
+
+    namespace detail
+    {
+        inline void storeLe(uint8_t *out, uint64_t value, unsigned bytes) noexcept
+        {
+            for (unsigned k = 0; k < bytes; ++k)
+                out[k] = static_cast<uint8_t>(value >> (8 * k));
+        }
+
+        inline uint64_t loadLe(const uint8_t *in, unsigned bytes) noexcept
+        {
+            uint64_t value = 0;
+            for (unsigned k = 0; k < bytes; ++k)
+                value |= static_cast<uint64_t>(in[k]) << (8 * k);
+            return value;
+        }
+
+        inline std::size_t captureRecordSize(CaptureFormat format) noexcept
+        {
+            return format == CaptureFormat::Packed16 ? 2 : 4;
+        }
+    }
+
+    // Пишет переходы в файл записи. Записи копятся в буфере и уходят на диск
+    // крупными блоками; число записей в заголовке обновляет close().
+    class CaptureWriter
+    {
+    public:
+        CaptureWriter() noexcept
+            : file_(nullptr), format_(CaptureFormat::Raw32), tick_(1), min_duration_(0), count_(0), buffered_(0)
+        {
+        }
+
+        CaptureWriter(const CaptureWriter &) = delete;
+        CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+        ~CaptureWriter() { close(); }
+
+        // tick для Packed16; 0 - config.duration
+        bool open(const char *path, const ProtocolConfig &config, CaptureFormat format = CaptureFormat::Raw32,
+                  long tick = 0)
+        {
+            close();
+            format_ = format;
+            tick_ = tick > 0 ? tick : (config.duration > 0 ? config.duration : 1);
+            min_duration_ = config.min_duration;
+            count_ = 0;
+            buffered_ = 0;
+            uint8_t header[kCaptureHeaderSize] = {'D', 'P', 'C', '1'};
+            detail::storeLe(header + 4, kCaptureVersion, 2);
+            header[6] = static_cast<uint8_t>(format);
+            header[7] = static_cast<uint8_t>(config.modulation);
+            detail::storeLe(header + 8, static_cast<uint64_t>(tick_), 4);
+            detail::storeLe(header + 12, static_cast<uint32_t>(config.min_duration), 4);
+            detail::storeLe(header + 16, static_cast<uint32_t>(config.duration), 4);
+            header[20] = static_cast<uint8_t>(config.segmented | config.frame_sync << 1 | config.run_length << 2 |
+                                              config.length_packet << 3 | config.clock_recovery << 4);
+            header[21] = config.fec_group;
+            header[22] = config.fec_depth;
+            file_ = std::fopen(path, "wb");
+            if (!file_)
+                return false;
+            if (std::fwrite(header, 1, sizeof(header), file_) != sizeof(header))
+            {
+                std::fclose(file_);
+                file_ = nullptr;
+                return false;
+            }
+            return true;
+        }
+
+        bool isOpen() const noexcept { return file_ != nullptr; }
+
+        std::size_t size() const noexcept { return count_; }
+
+        bool write(const SignalChange *signals, std::size_t count)
+        {
+            if (!file_)
+                return false;
+            const std::size_t recordSize = detail::captureRecordSize(format_);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                if (buffered_ + recordSize > sizeof(buffer_) && !flush())
+                    return false;
+                const SignalChange &sc = signals[i];
+                const uint32_t level = static_cast<uint32_t>(sc.value) & 0x1F;
+                if (format_ == CaptureFormat::Packed16)
+                {
+                    const long ticks = detail::quantizeTicks(sc.duration, tick_, min_duration_, 0x07FF);
+                    detail::storeLe(buffer_ + buffered_, static_cast<uint32_t>(ticks) << 5 | level, 2);
+                }
+                else
+                {
+                    long duration = sc.duration > 0 ? sc.duration : 0;
+                    if (duration > 0x07FFFFFF)
+                        duration = 0x07FFFFFF;
+                    detail::storeLe(buffer_ + buffered_, static_cast<uint32_t>(duration) << 5 | level, 4);
+                }
+                buffered_ += recordSize;
+            }
+            count_ += count;
+            return true;
+        }
+
+        bool write(const SignalChange &sc) { return write(&sc, 1); }
+
+        // Дописывает буфер и число записей; false, если что-то не записалось
+        bool close()
+        {
+            if (!file_)
+                return true;
+            bool ok = flush();
+            uint8_t count[8];
+            detail::storeLe(count, count_, 8);
+            ok = ok && std::fseek(file_, 24, SEEK_SET) == 0 && std::fwrite(count, 1, sizeof(count), file_) == sizeof(count);
+            ok = std::fclose(file_) == 0 && ok;
+            file_ = nullptr;
+            return ok;
+        }
+
+    private:
+        bool flush()
+        {
+            const bool ok = std::fwrite(buffer_, 1, buffered_, file_) == buffered_;
+            buffered_ = 0;
+            return ok;
+        }
+
+        std::FILE *file_;
+        CaptureFormat format_;
+        long tick_;
+        long min_duration_;
+        uint64_t count_;
+        std::size_t buffered_;
+        uint8_t buffer_[1 << 16];
+    };
+
+    // Читает файл записи. На POSIX файл отображается в память целиком, и записи
+    // разворачиваются в SignalChange прямо из страниц отображения небольшими
+    // пачками, которые остаются в кэше до bulk feed. Без mmap файл читается в память.
+    class CaptureReader
+    {
+    public:
+        static constexpr std::size_t kReplayBlock = 4096; // переходов на один вызов feed
+
+        CaptureReader() noexcept : data_(nullptr), mapped_(0), records_(nullptr), count_(0), format_(CaptureFormat::Raw32), tick_(1) {}
+
+        CaptureReader(const CaptureReader &) = delete;
+        CaptureReader &operator=(const CaptureReader &) = delete;
+
+        ~CaptureReader() { close(); }
+
+        // false - файл не открылся, не отобразился или это не запись datapack
+        bool open(const char *path)
+        {
+            close();
+#if DATAPACK_HAS_MMAP
+            const int fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat info;
+            if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(kCaptureHeaderSize))
+            {
+                ::close(fd);
+                return false;
+            }
+            void *mapping = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+                return false;
+            data_ = static_cast<const uint8_t *>(mapping);
+            mapped_ = static_cast<std::size_t>(info.st_size);
+#ifdef MADV_SEQUENTIAL
+            ::madvise(mapping, mapped_, MADV_SEQUENTIAL);
+#endif
+#else
+            std::FILE *file = std::fopen(path, "rb");
+            if (!file)
+                return false;
+            uint8_t chunk[1 << 16];
+            while (std::size_t n = std::fread(chunk, 1, sizeof(chunk), file))
+                copy_.insert(copy_.end(), chunk, chunk + n);
+            std::fclose(file);
+            data_ = copy_.data();
+            mapped_ = copy_.size();
+#endif
+            if (!parseHeader())
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() noexcept
+        {
+#if DATAPACK_HAS_MMAP
+            if (data_)
+                ::munmap(const_cast<uint8_t *>(data_), mapped_);
+#else
+            copy_.clear();
+#endif
+            data_ = nullptr;
+            mapped_ = 0;
+            records_ = nullptr;
+            count_ = 0;
+        }
+
+        bool isOpen() const noexcept { return data_ != nullptr; }
+
+        // Настройки передачи из заголовка
+        const ProtocolConfig &config() const noexcept { return config_; }
+
+        CaptureFormat format() const noexcept { return format_; }
+
+        long tick() const noexcept { return tick_; }
+
+        // Число записей (у обрезанного файла - сколько поместилось целиком)
+        std::size_t size() const noexcept { return count_; }
+
+        SignalChange operator[](std::size_t index) const noexcept
+        {
+            if (format_ == CaptureFormat::Packed16)
+            {
+                const uint32_t packed = static_cast<uint32_t>(detail::loadLe(records_ + 2 * index, 2));
+                return {static_cast<LightLevel>(packed & 0x1F), static_cast<long>(packed >> 5) * tick_};
+            }
+            const uint32_t packed = static_cast<uint32_t>(detail::loadLe(records_ + 4 * index, 4));
+            return {static_cast<LightLevel>(packed & 0x1F), static_cast<long>(packed >> 5)};
+        }
+
+        // Разворачивает count записей начиная с first в out, возвращает сколько развернул
+        std::size_t read(std::size_t first, std::size_t count, SignalChange *out) const noexcept
+        {
+            if (first >= count_)
+                return 0;
+            if (count > count_ - first)
+                count = count_ - first;
+            // формат выбирается один раз на пачку, а не на запись
+            if (format_ == CaptureFormat::Packed16)
+            {
+                const uint8_t *in = records_ + 2 * first;
+                for (std::size_t i = 0; i < count; ++i, in += 2)
+                {
+                    const uint32_t packed = static_cast<uint32_t>(detail::loadLe(in, 2));
+                    out[i] = {static_cast<LightLevel>(packed & 0x1F), static_cast<long>(packed >> 5) * tick_};
+                }
+            }
+            else
+            {
+                const uint8_t *in = records_ + 4 * first;
+                for (std::size_t i = 0; i < count; ++i, in += 4)
+                {
+                    const uint32_t packed = static_cast<uint32_t>(detail::loadLe(in, 4));
+                    out[i] = {static_cast<LightLevel>(packed & 0x1F), static_cast<long>(packed >> 5)};
+                }
+            }
+            return count;
+        }
+
+        // Прогоняет записи [first, first + count) через decoder пачками по kReplayBlock;
+        // возвращает число найденных пакетов (они приходят в коллбэк или очередь декодера)
+        template <typename Protocol>
+        std::size_t replay(BasicDecoder<Protocol> &decoder, std::size_t first = 0,
+                           std::size_t count = static_cast<std::size_t>(-1)) const noexcept
+        {
+            SignalChange block[kReplayBlock];
+            std::size_t found = 0;
+            if (first >= count_)
+                return 0;
+            const std::size_t end = count > count_ - first ? count_ : first + count;
+            for (std::size_t position = first; position < end; position += kReplayBlock)
+            {
+                const std::size_t n = read(position, end - position < kReplayBlock ? end - position : kReplayBlock, block);
+                found += decoder.feed(block, n);
+            }
+            return found;
+        }
+
+    private:
+        bool parseHeader() noexcept
+        {
+            const uint8_t *header = data_;
+            if (header[0] != 'D' || header[1] != 'P' || header[2] != 'C' || header[3] != '1' ||
+                detail::loadLe(header + 4, 2) != kCaptureVersion || header[6] > static_cast<uint8_t>(CaptureFormat::Packed16))
+                return false;
+            format_ = static_cast<CaptureFormat>(header[6]);
+            config_ = ProtocolConfig();
+            config_.modulation = header[7] == static_cast<uint8_t>(Modulation::Intensity4) ? Modulation::Intensity4
+                                                                                           : Modulation::Classic;
+            tick_ = static_cast<long>(detail::loadLe(header + 8, 4));
+            if (tick_ <= 0)
+                tick_ = 1;
+            config_.min_duration = static_cast<int32_t>(detail::loadLe(header + 12, 4));
+            config_.duration = static_cast<int32_t>(detail::loadLe(header + 16, 4));
+            config_.segmented = header[20] & 1;
+            config_.frame_sync = header[20] & 2;
+            config_.run_length = header[20] & 4;
+            config_.length_packet = header[20] & 8;
+            config_.clock_recovery = header[20] & 16;
+            config_.fec_group = header[21];
+            config_.fec_depth = header[22];
+            records_ = data_ + kCaptureHeaderSize;
+            // запись, оборванная посреди работы, читается до последней целой записи
+            const uint64_t stored = detail::loadLe(header + 24, 8);
+            const uint64_t present = (mapped_ - kCaptureHeaderSize) / detail::captureRecordSize(format_);
+            count_ = static_cast<std::size_t>(stored != 0 && stored < present ? stored : present);
+            return true;
+        }
+
+        const uint8_t *data_;
+        std::size_t mapped_;
+        const uint8_t *records_;
+        std::size_t count_;
+        CaptureFormat format_;
+        long tick_;
+        ProtocolConfig config_;
+#if !DATAPACK_HAS_MMAP
+        std::vector<uint8_t> copy_;
+#endif
+    };
+}
+
+namespace datapack
+{
+    namespace detail
+    {
+        // Абсолютный срок на монотонных часах: ошибки сна не накапливаются от символа к символу
+        class MonotonicDeadline
+        {
+        public:
+            void reset() noexcept
+            {
+#if DATAPACK_HAS_CLOCK_NANOSLEEP
+                clock_gettime(CLOCK_MONOTONIC, &deadline_);
+#else
+                deadline_ = std::chrono::steady_clock::now();
+#endif
+            }
+
+            void advance(long long ns) noexcept
+            {
+#if DATAPACK_HAS_CLOCK_NANOSLEEP
+                ns += deadline_.tv_nsec;
+                long long sec = ns / 1000000000;
+                ns %= 1000000000;
+                if (ns < 0)
+                {
+                    // отрицательный сдвиг: tv_nsec должен остаться в [0, 1e9)
+                    ns += 1000000000;
+                    --sec;
+                }
+                deadline_.tv_sec += static_cast<time_t>(sec);
+                deadline_.tv_nsec = static_cast<long>(ns);
+#else
+                deadline_ += std::chrono::nanoseconds(ns);
+#endif
+            }
+
+            void sleep() const noexcept
+            {
+#if DATAPACK_HAS_CLOCK_NANOSLEEP
+                // EINTR - досыпаем до того же срока; другие ошибки (неверный срок)
+                // повтором не исправить
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline_, nullptr) == EINTR)
+                {
+                }
+#else
+                std::this_thread::sleep_until(deadline_);
+#endif
+            }
+
+        private:
+#if DATAPACK_HAS_CLOCK_NANOSLEEP
+            timespec deadline_{};
+#else
+            std::chrono::steady_clock::time_point deadline_;
+#endif
+        };
+    }
+
+    // BasicTransmitter на рабочей станции: таймером служит отдельный поток, который
+    // спит до абсолютного срока каждого символа (clock_nanosleep на Linux) и между
+    // символами дозаполняет буферы. Сообщения копируются, так что буфер вызывающего
+    // можно переиспользовать сразу после send. Длительность символа в
+    // ProtocolConfig - в единицах tickNs наносекунд (по умолчанию микросекунды).
+    template <typename Protocol = DefaultProtocol>
+    class BasicHostTransmitter
+    {
+    public:
+        using LevelCallback = void (*)(LightLevel level, void *context);
+
+        BasicHostTransmitter(LevelCallback callback, void *context, const ProtocolConfig &config = Protocol::config,
+                             long tickNs = 1000)
+            : callback_(callback), context_(context), tick_ns_(tickNs),
+              transmitter_(TransmitDriver{setLevel, arm, this}, config), slot_(0), stop_(false)
+        {
+            thread_ = std::thread([this] { run(); });
+        }
+
+        BasicHostTransmitter(const BasicHostTransmitter &) = delete;
+        BasicHostTransmitter &operator=(const BasicHostTransmitter &) = delete;
+
+        ~BasicHostTransmitter() { stop(); }
+
+        // Ставит сообщение в очередь; если одно уже ждёт, блокируется, пока оно не
+        // начнёт кодироваться. false - передатчик остановлен.
+        bool send(const uint8_t *data, std::size_t len)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] { return stop_ || !transmitter_.pending(); });
+            if (stop_)
+                return false;
+            // одно сообщение кодируется, в другое пишем: третьего не бывает (см. pending)
+            messages_[slot_].assign(data, data + len);
+            transmitter_.send(messages_[slot_].data(), len);
+            slot_ ^= 1;
+            changed_.notify_all();
+            return true;
+        }
+
+        // Ждёт, пока всё отправленное не будет передано
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] { return stop_ || transmitter_.idle(); });
+        }
+
+        // Останавливает поток; непереданные символы отбрасываются
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            changed_.notify_all();
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+    private:
+        static void setLevel(LightLevel level, void *context)
+        {
+            BasicHostTransmitter *self = static_cast<BasicHostTransmitter *>(context);
+            if (self->callback_)
+                self->callback_(level, self->context_);
+        }
+
+        static void arm(long duration, void *context)
+        {
+            BasicHostTransmitter *self = static_cast<BasicHostTransmitter *>(context);
+            self->deadline_.advance(static_cast<long long>(duration) * self->tick_ns_);
+        }
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!stop_)
+            {
+                if (!transmitter_.running())
+                {
+                    // отсчёт первого символа - от момента запуска
+                    deadline_.reset();
+                    if (!transmitter_.pump())
+                    {
+                        changed_.notify_all();
+                        changed_.wait(lock, [this] { return stop_ || !transmitter_.idle(); });
+                    }
+                    continue;
+                }
+                transmitter_.pump();
+                if (!transmitter_.pending())
+                    changed_.notify_all();
+                lock.unlock();
+                deadline_.sleep();
+                // onTimer трогает только состояние потребителя - блокировка не нужна
+                transmitter_.onTimer();
+                lock.lock();
+                if (!transmitter_.running())
+                    changed_.notify_all();
+            }
+            setLevel(LightLevel::Off, this);
+        }
+
+        LevelCallback callback_;
+        void *context_;
+        long tick_ns_;
+        BasicTransmitter<Protocol> transmitter_;
+        detail::MonotonicDeadline deadline_;
+        std::vector<uint8_t> messages_[2];
+        int slot_;
+        bool stop_;
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        std::thread thread_;
+    };
+
+    using HostTransmitter = BasicHostTransmitter<>;
+}
+
+#if DATAPACK_HAS_COROUTINES
+namespace datapack
+{
+    // Асинхронный генератор для конвейеров на корутинах C++20. Потребитель пишет
+    // while (const T *v = co_await gen.next()); значение живёт до следующего next().
+    // Генератор ленивый и передаёт управление симметрично: next() сразу возобновляет
+    // производителя, co_yield - потребителя. Если стадия ждёт внешний источник,
+    // конвейер продолжит тот поток, на котором источник её возобновит, без лишних
+    // переходов между потоками. Кадр корутины выделяется в куче.
+    template <typename T>
+    class AsyncGenerator
+    {
+    public:
+        struct promise_type;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        struct promise_type
+        {
+            const T *value = nullptr;
+            std::coroutine_handle<> consumer;
+            std::exception_ptr error;
+
+            // возврат управления тому, кто ждёт next()
+            struct Resume
+            {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(Handle self) noexcept { return self.promise().consumer; }
+                void await_resume() const noexcept {}
+            };
+
+            AsyncGenerator get_return_object() noexcept { return AsyncGenerator(Handle::from_promise(*this)); }
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            Resume final_suspend() const noexcept { return {}; }
+
+            // временный объект в co_yield живёт до возобновления, так что хватает указателя
+            Resume yield_value(const T &item) noexcept
+            {
+                value = std::addressof(item);
+                return {};
+            }
+
+            void return_void() noexcept { value = nullptr; }
+            void unhandled_exception() noexcept
+            {
+                value = nullptr;
+                error = std::current_exception();
+            }
+        };
+
+        struct NextAwaiter
+        {
+            Handle producer;
+
+            bool await_ready() const noexcept { return !producer || producer.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept
+            {
+                producer.promise().consumer = consumer;
+                return producer;
+            }
+            // nullptr - поток кончился; исключение стадии пробрасывается потребителю
+            const T *await_resume() const
+            {
+                if (!producer)
+                    return nullptr;
+                if (producer.done())
+                {
+                    if (producer.promise().error)
+                        std::rethrow_exception(producer.promise().error);
+                    return nullptr;
+                }
+                return producer.promise().value;
+            }
+        };
+
+        AsyncGenerator() noexcept = default;
+        AsyncGenerator(AsyncGenerator &&other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+        AsyncGenerator &operator=(AsyncGenerator &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle_)
+                    handle_.destroy();
+                handle_ = other.handle_;
+                other.handle_ = nullptr;
+            }
+            return *this;
+        }
+        AsyncGenerator(const AsyncGenerator &) = delete;
+        AsyncGenerator &operator=(const AsyncGenerator &) = delete;
+
+        ~AsyncGenerator()
+        {
+            if (handle_)
+                handle_.destroy();
+        }
+
+        NextAwaiter next() noexcept { return {handle_}; }
+
+    private:
+        explicit AsyncGenerator(Handle handle) noexcept : handle_(handle) {}
+
+        Handle handle_;
+    };
+
+    namespace detail
+    {
+        // Сразу запущенная корутина без результата: хвост конвейера в forEach
+        struct DetachedTask
+        {
+            struct promise_type
+            {
+                DetachedTask get_return_object() const noexcept { return {}; }
+                std::suspend_never initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                void unhandled_exception() const noexcept { std::terminate(); }
+            };
+        };
+    }
+
+    // Стадии ниже принимают любой источник, у которого co_await source.next()
+    // даёт указатель на элемент или nullptr в конце, - AsyncGenerator или свой
+    // асинхронный диапазон поверх исполнителя приложения. Источник переходит во
+    // владение стадии.
+
+    // Переходы из памяти как источник конвейера; память должна жить, пока он читается
+    inline AsyncGenerator<SignalChange> signalSource(const SignalChange *signals, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            co_yield signals[i];
+    }
+
+    // Тот же фильтр, что на входе декодера: отбрасывает глитчи короче minDuration
+    // и повторы уровня. Нужен, когда отфильтрованный поток идёт не только в декодер
+    // (запись, несколько декодеров).
+    template <typename Source>
+    AsyncGenerator<SignalChange> filterGlitches(Source source, long minDuration)
+    {
+        LightLevel prev = LightLevel::Off;
+        while (const SignalChange *sc = co_await source.next())
+        {
+            if (sc->duration < minDuration || sc->value == prev)
+                continue;
+            prev = sc->value;
+            co_yield *sc;
+        }
+    }
+
+    // Пакеты по мере декодирования, в том же порядке, что даёт feed. Восстановление
+    // тактов и FEC делает сам декодер по своему ProtocolConfig.
+    template <typename Protocol, typename Source>
+    AsyncGenerator<UnpackedPackage> decodePackets(BasicDecoder<Protocol> &decoder, Source source)
+    {
+        // один переход завершает не больше двух пакетов (кандидат и новый пакет)
+        UnpackedPackage found[2];
+        while (const SignalChange *sc = co_await source.next())
+        {
+            const std::size_t count = decoder.feed(sc, 1, found, 2);
+            for (std::size_t k = 0; k < count; ++k)
+                co_yield found[k];
+        }
+    }
+
+    namespace detail
+    {
+        // Сообщения, собранные за один feed: граница сообщения может прийти в том
+        // же переходе, что и первый пакет следующего, поэтому копия снимается в
+        // коллбэке, а не после feed
+        template <std::size_t MaxWords>
+        struct MessageInbox
+        {
+            uint8_t data[2][MaxWords * 2];
+            std::size_t size[2];
+            std::size_t count = 0;
+
+            static void store(const uint8_t *message, std::size_t len, void *context) noexcept
+            {
+                MessageInbox &inbox = *static_cast<MessageInbox *>(context);
+                if (inbox.count == 2)
+                    return;
+                std::memcpy(inbox.data[inbox.count], message, len);
+                inbox.size[inbox.count++] = len;
+            }
+        };
+
+        // Возвращает декодеру коллбэк и запасной буфер, даже если стадию бросили на середине
+        template <typename Decoder>
+        struct MessageStageGuard
+        {
+            Decoder &decoder;
+
+            ~MessageStageGuard()
+            {
+                decoder.setMessageCallback(nullptr);
+                decoder.setSpareBuffer(nullptr);
+            }
+        };
+    }
+
+    // Собранные сообщения (с FEC - уже восстановленные). Нужен length_packet: без
+    // служебного пакета длины декодер не знает, что сообщение кончилось. Пока стадия
+    // жива, она занимает коллбэк сообщения и запасной буфер декодера (setSpareBuffer),
+    // так что следующее сообщение принимается без reset(). После каждого сообщения
+    // захват frame_sync и сегмент начинаются заново (restartSync): следующее сообщение
+    // ищется с любой фазы, хоть вплотную, хоть после паузы. Вид действует до следующего next().
+    template <typename Protocol, typename Source>
+    AsyncGenerator<ByteView> decodeMessages(BasicDecoder<Protocol> &decoder, Source source)
+    {
+        detail::MessageInbox<Protocol::max_words> inbox;
+        uint16_t spare[Protocol::max_words];
+        const detail::MessageStageGuard<BasicDecoder<Protocol>> guard{decoder};
+        decoder.setSpareBuffer(spare);
+        decoder.setMessageCallback(inbox.store, &inbox);
+        while (const SignalChange *sc = co_await source.next())
+        {
+            inbox.count = 0;
+            decoder.feed(*sc);
+            if (inbox.count != 0)
+                decoder.restartSync();
+            for (std::size_t k = 0; k < inbox.count; ++k)
+                co_yield ByteView{inbox.data[k], inbox.size[k]};
+        }
+    }
+
+    // Прогоняет конвейер до конца, отдавая элементы callback. С синхронными
+    // источниками возвращается, когда поток кончился; если стадия ждёт внешнее
+    // событие, остаток доработает тот, кто её возобновит.
+    template <typename Source, typename Callback>
+    detail::DetachedTask forEach(Source source, Callback callback)
+    {
+        while (const auto *item = co_await source.next())
+            callback(*item);
+    }
+}
+#endif
@@ -0,0 +1,283 @@
+/*
+ * datapacklib_wasm.js
+ * JavaScript API of datapacklib.js on top of the WebAssembly build of the C++ core (datapacklib_c.h).
+ */
+
+(function (globalScope, factory) {
+	const api = factory(globalScope);
+
+	if (typeof module === "object" && typeof module.exports === "object") {
+		module.exports = api;
+	} else if (typeof define === "function" && define.amd) {
+		define([], () => api);
+	}
+
+	if (globalScope && typeof globalScope === "object") {
+		globalScope.datapackWasm = api;
+	}
+})(typeof globalThis !== "undefined" ? globalThis : typeof self !== "undefined" ? self : this, function (globalScope) {
+	"use strict";
+
+	// Переходы в буфере - пары Int32 (уровень, длительность), пакеты - Uint32
+	// segment << 24 | index << 16 | word, как в datapacklib_c.h
+	const PAIR_BYTES = 8;
+	const CONFIG_BYTES = 12;
+
+	const LightLevel = Object.freeze({
+		Off: 0,
+		White: 1,
+		Red: 2,
+		Green: 3,
+		Blue: 4,
+	});
+
+	const isValidLightLevel = (value) => Number.isInteger(value) && value >= 0 && value <= 4;
+
+	const toUint8Array = (input) => {
+		if (input instanceof Uint8Array) {
+			return input;
+		}
+		if (input instanceof ArrayBuffer) {
+			return new Uint8Array(input);
+		}
+		if (ArrayBuffer.isView(input)) {
+			return new Uint8Array(input.buffer, input.byteOffset, input.byteLength);
+		}
+		if (typeof input === "string") {
+			return typeof TextEncoder !== "undefined"
+				? new TextEncoder().encode(input)
+				: Uint8Array.from(input.split("").map((ch) => ch.charCodeAt(0)));
+		}
+		if (Array.isArray(input)) {
+			return Uint8Array.from(input);
+		}
+		throw new TypeError(
+			"setSendData expects a string, ArrayBuffer, Uint8Array or array-like input"
+		);
+	};
+
+	// Обёртка над уже загруженным модулем Emscripten (core)
+	const bind = (core) => {
+		let minDuration = 60;
+		let signalDuration = 125;
+		let packetHandler = null;
+
+		const maxTransitions = core._datapack_max_transitions();
+		const maxMessage = core._datapack_max_message();
+
+		const config = core._malloc(CONFIG_BYTES);
+		const writeConfig = () => {
+			core._datapack_config_default(config);
+			core.HEAP32[config >> 2] = minDuration;
+			core.HEAP32[(config >> 2) + 1] = signalDuration;
+			return config;
+		};
+
+		const encoder = core._datapack_encoder_create(writeConfig());
+		const decoder = core._datapack_decoder_create(config);
+		const sendTransitions = core._malloc(maxTransitions * PAIR_BYTES);
+		const messageBuffer = core._malloc(maxMessage);
+		let sendData = new Uint8Array(0);
+		let sendCount = 0;
+
+		// Рабочий буфер feed растёт по мере надобности; после malloc виды HEAP*
+		// могут смениться (рост памяти), поэтому они читаются заново при каждом обращении.
+		let feedBuffer = 0;
+		let feedCapacity = 0;
+		let packetBuffer = 0;
+		const reserveFeed = (count) => {
+			if (count <= feedCapacity) {
+				return;
+			}
+			core._free(feedBuffer);
+			core._free(packetBuffer);
+			feedCapacity = Math.max(count, 1024);
+			feedBuffer = core._malloc(feedCapacity * PAIR_BYTES);
+			packetBuffer = core._malloc(feedCapacity * 4);
+		};
+
+		const applyConfig = () => {
+			writeConfig();
+			core._datapack_encoder_set_config(encoder, config);
+			core._datapack_decoder_set_config(decoder, config);
+		};
+
+		const encode = () => {
+			const data = core._malloc(Math.max(sendData.length, 1));
+			core.HEAPU8.set(sendData, data);
+			sendCount = core._datapack_encode(encoder, data, sendData.length, sendTransitions, maxTransitions);
+			core._free(data);
+		};
+
+		const setSendData = (input, byteLength) => {
+			const bytes = toUint8Array(input);
+			const limit = Math.min(typeof byteLength === "number" ? byteLength : bytes.length, maxMessage);
+			sendData = bytes.slice(0, limit);
+			encode();
+		};
+
+		const getSendBuffer = () => {
+			const words = [];
+			for (let i = 0; i < sendData.length; i += 2) {
+				words.push(sendData[i] | (i + 1 < sendData.length ? sendData[i + 1] << 8 : 0));
+			}
+			return words;
+		};
+
+		// Переходы текущего сообщения одним Int32Array (копия)
+		const getSendTransitions = () =>
+			core.HEAP32.slice(sendTransitions >> 2, (sendTransitions >> 2) + sendCount * 2);
+
+		const getSendCommands = () => {
+			const pairs = getSendTransitions();
+			const commands = new Array(sendCount);
+			for (let i = 0; i < sendCount; i += 1) {
+				commands[i] = { value: pairs[2 * i], duration: pairs[2 * i + 1] };
+			}
+			return commands;
+		};
+
+		// Одна граница JS/WASM на пачку: пары копируются в память модуля, пакеты
+		// возвращаются массивом и раздаются коллбэку уже на стороне JS
+		const feedPairs = (pairs, count) => {
+			reserveFeed(count);
+			core.HEAP32.set(pairs.subarray(0, count * 2), feedBuffer >> 2);
+			const found = core._datapack_decoder_feed(decoder, feedBuffer, count, packetBuffer, feedCapacity);
+			const packets = core.HEAPU32.slice(packetBuffer >> 2, (packetBuffer >> 2) + Math.min(found, feedCapacity));
+			let last = null;
+			for (const packet of packets) {
+				last = { valid: true, index: (packet >>> 16) & 0xff, word: packet & 0xffff };
+				if (typeof packetHandler === "function") {
+					packetHandler({ ...last });
+				}
+			}
+			return { found, last };
+		};
+
+		const toPairs = (commands) => {
+			const pairs = new Int32Array(commands.length * 2);
+			for (let i = 0; i < commands.length; i += 1) {
+				pairs[2 * i] = commands[i].value;
+				pairs[2 * i + 1] = commands[i].duration;
+			}
+			return pairs;
+		};
+
+		// feed({ value, duration }) - как в datapacklib.js: пакет или null.
+		// feed(Int32Array пар) или feed(массив переходов) - bulk, возвращает число пакетов.
+		const feed = (input) => {
+			if (input instanceof Int32Array) {
+				return feedPairs(input, input.length >> 1).found;
+			}
+			if (Array.isArray(input)) {
+				return feedPairs(toPairs(input), input.length).found;
+			}
+			if (!input || typeof input !== "object") {
+				throw new TypeError("feed expects an object with value and duration fields or an Int32Array");
+			}
+			const { value, duration } = input;
+			if (!isValidLightLevel(value)) {
+				throw new RangeError("signalChange.value must be a valid LightLevel");
+			}
+			if (typeof duration !== "number" || Number.isNaN(duration)) {
+				throw new TypeError("signalChange.duration must be a finite number");
+			}
+			return feedPairs(Int32Array.of(value, duration), 1).last;
+		};
+
+		const getReceivedWords = () => {
+			core._datapack_decoder_received_words(decoder, messageBuffer);
+			return core.HEAPU16.slice(messageBuffer >> 1, (messageBuffer >> 1) + maxMessage / 2);
+		};
+
+		// Как в datapacklib.js - весь буфер приёма (память WASM всегда little-endian)
+		const getReceivedData = () => {
+			core._datapack_decoder_received_words(decoder, messageBuffer);
+			return core.HEAPU8.slice(messageBuffer, messageBuffer + maxMessage);
+		};
+
+		// Только достоверные байты: собранное сообщение или принятый без пропусков префикс
+		const getVerifiedData = () => {
+			const length = core._datapack_decoder_received_data(decoder, messageBuffer, maxMessage);
+			return core.HEAPU8.slice(messageBuffer, messageBuffer + length);
+		};
+
+		const setOnPacketReceived = (handler) => {
+			if (handler !== null && typeof handler !== "function") {
+				throw new TypeError("Packet handler must be a function or null");
+			}
+			packetHandler = handler;
+		};
+
+		const setMinDuration = (value) => {
+			if (typeof value !== "number" || !Number.isFinite(value) || value < 0) {
+				throw new RangeError("minDuration must be a non-negative finite number");
+			}
+			minDuration = value;
+			applyConfig();
+		};
+
+		const setSignalDuration = (value) => {
+			if (typeof value !== "number" || !Number.isFinite(value) || value <= 0) {
+				throw new RangeError("signal duration must be a positive finite number");
+			}
+			signalDuration = value;
+			applyConfig();
+			encode();
+		};
+
+		const resetDecoder = () => core._datapack_decoder_reset(decoder);
+
+		const resetEncoder = () => {
+			sendData = new Uint8Array(0);
+			sendCount = 0;
+		};
+
+		// Освобождает память модуля; после вызова экземпляром пользоваться нельзя
+		const destroy = () => {
+			core._datapack_encoder_destroy(encoder);
+			core._datapack_decoder_destroy(decoder);
+			[config, sendTransitions, messageBuffer, feedBuffer, packetBuffer].forEach((ptr) => core._free(ptr));
+		};
+
+		return {
+			LightLevel,
+			getMinDuration: () => minDuration,
+			setMinDuration,
+			getSignalDuration: () => signalDuration,
+			setSignalDuration,
+			setOnPacketReceived,
+			setSendData,
+			getSendBuffer,
+			getSendCommands,
+			getSendTransitions,
+			getReceivedWords,
+			getReceivedData,
+			getVerifiedData,
+			isComplete: () => core._datapack_decoder_complete(decoder) !== 0,
+			feed,
+			resetDecoder,
+			resetEncoder,
+			destroy,
+		};
+	};
+
+	// Загружает модуль (по умолчанию - datapacklib_core.js рядом, см. README) и
+	// возвращает Promise с API. factory - фабрика Emscripten (MODULARIZE) или готовый модуль.
+	const load = async (factory, moduleOptions) => {
+		let source = factory;
+		if (!source && typeof require === "function") {
+			source = require("./datapacklib_core.js");
+		}
+		if (!source && globalScope && typeof globalScope.createDatapackCore === "function") {
+			source = globalScope.createDatapackCore;
+		}
+		if (!source) {
+			throw new Error("datapacklib_core.js is not loaded");
+		}
+		const core = typeof source === "function" ? await source(moduleOptions || {}) : source;
+		return bind(core);
+	};
+
+	return { LightLevel, load, bind };
+});
@@ -31,9 +31,7 @@ int main() {
 
     // Симулируем прием: подаем все команды обратно в feed
     std::cout << "\nSimulating reception..." << std::endl;
-    for (size_t i = 0; i < datapack::send_commands.size(); ++i) {
-        datapack::feed(datapack::send_commands[i]);
-    }
+    datapack::feed(datapack::send_commands.data(), datapack::send_commands.size());
 
     // Получаем полученные данные
     uint8_t receivedData[512];
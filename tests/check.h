@@ -0,0 +1,111 @@
+#pragma once
+
+#include "datapacklib.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Минимальная обвязка тестов: TEST регистрирует функцию, CHECK отмечает
+// провал и продолжает тест, чтобы за один прогон были видны все расхождения.
+
+namespace check
+{
+    using TestFunction = void (*)();
+
+    struct TestCase
+    {
+        const char *name;
+        TestFunction run;
+    };
+
+    inline std::vector<TestCase> &registry()
+    {
+        static std::vector<TestCase> tests;
+        return tests;
+    }
+
+    inline int failures = 0;
+
+    struct Registrar
+    {
+        Registrar(const char *name, TestFunction run) { registry().push_back({name, run}); }
+    };
+
+    inline void fail(const char *file, int line, const char *expression)
+    {
+        ++failures;
+        std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+    }
+
+    inline void failEqual(const char *file, int line, const char *a, const char *b, long long x, long long y)
+    {
+        ++failures;
+        std::fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", file, line, a, b, x, y);
+    }
+
+    // Сообщение из len байт с предсказуемым содержимым
+    inline std::vector<uint8_t> pattern(std::size_t len, uint8_t seed = 1)
+    {
+        std::vector<uint8_t> data(len);
+        uint32_t x = 0x9E3779B9u * (seed + 1u);
+        for (uint8_t &byte : data)
+        {
+            x = x * 1664525u + 1013904223u;
+            byte = static_cast<uint8_t>(x >> 24);
+        }
+        return data;
+    }
+
+    // Символы encode одним вектором
+    template <typename Encoder>
+    std::vector<datapack::SignalChange> encoded(const Encoder &encoder, const std::vector<uint8_t> &data)
+    {
+        typename Encoder::Signals out;
+        std::vector<datapack::SignalChange> symbols;
+        if (encoder.encode(data.data(), data.size(), out))
+            symbols.assign(out.data(), out.data() + out.size());
+        return symbols;
+    }
+
+    // Поэлементное сравнение символов (у SignalChange есть байты выравнивания)
+    inline bool sameSymbols(const datapack::SignalChange *a, const datapack::SignalChange *b, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (a[i].value != b[i].value || a[i].duration != b[i].duration)
+                return false;
+        }
+        return true;
+    }
+
+    // Принятые данные совпадают с data
+    template <typename Decoder>
+    bool receivedEquals(const Decoder &decoder, const std::vector<uint8_t> &data)
+    {
+        std::vector<uint8_t> received(Decoder::kMaxWords * 2);
+        const std::size_t len = decoder.getReceivedData(received.data(), received.size());
+        return len == data.size() && std::memcmp(received.data(), data.data(), len) == 0;
+    }
+}
+
+#define TEST(name)                                                                                                     \
+    static void name();                                                                                                \
+    static const check::Registrar name##_registrar(#name, name);                                                       \
+    static void name()
+
+#define CHECK(expression)                                                                                              \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(expression))                                                                                             \
+            check::fail(__FILE__, __LINE__, #expression);                                                              \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                                 \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        const long long check_a = static_cast<long long>(a);                                                           \
+        const long long check_b = static_cast<long long>(b);                                                           \
+        if (check_a != check_b)                                                                                        \
+            check::failEqual(__FILE__, __LINE__, #a, #b, check_a, check_b);                                            \
+    } while (0)
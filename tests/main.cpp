@@ -0,0 +1,26 @@
+#include "check.h"
+
+#include <string>
+
+// Прогоняет все зарегистрированные тесты; аргумент - подстрока имени, как у benchmark.cpp.
+// Код возврата 1, если хоть одна проверка не прошла.
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : nullptr;
+    int run = 0;
+    int failed = 0;
+    for (const check::TestCase &test : check::registry())
+    {
+        if (filter && std::string(test.name).find(filter) == std::string::npos)
+            continue;
+        const int before = check::failures;
+        test.run();
+        ++run;
+        const bool ok = check::failures == before;
+        failed += !ok;
+        std::printf("%-48s %s\n", test.name, ok ? "ok" : "FAILED");
+    }
+    std::printf("%d tests, %d failed\n", run, failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include "check.h"
+
+using namespace datapack;
+
+// Упакованные буферы хранят вывод Encoder без потерь, и декодер принимает его из copyTo
+TEST(packed_buffers_round_trip)
+{
+    const std::vector<uint8_t> data = check::pattern(64, 2);
+    const auto symbols = check::encoded(Encoder(), data);
+
+    PackedSignalBuffer<kMaxSymbols> packed;
+    LevelSignalBuffer<kMaxSymbols> levels;
+    for (const SignalChange &sc : symbols)
+    {
+        CHECK(packed.push_back(sc));
+        CHECK(levels.push_back(sc));
+    }
+    CHECK_EQ(packed.size(), symbols.size());
+    CHECK_EQ(levels.size(), symbols.size());
+
+    std::vector<SignalChange> unpacked(symbols.size());
+    CHECK_EQ(packed.copyTo(0, unpacked.size(), unpacked.data()), symbols.size());
+    CHECK(check::sameSymbols(unpacked.data(), symbols.data(), symbols.size()));
+    CHECK_EQ(levels.copyTo(0, unpacked.size(), unpacked.data()), symbols.size());
+    CHECK(check::sameSymbols(unpacked.data(), symbols.data(), symbols.size()));
+
+    std::size_t i = 0;
+    for (SignalChange sc : levels)
+        CHECK(i < symbols.size() && sc.value == symbols[i++].value);
+    CHECK_EQ(i, symbols.size());
+
+    ProtocolConfig config;
+    config.frame_sync = true;
+    Decoder decoder(nullptr, nullptr, config);
+    SignalChange block[37];
+    for (std::size_t first = 0; first < packed.size(); first += 37)
+    {
+        const std::size_t n = packed.copyTo(first, 37, block);
+        decoder.feed(block, n);
+    }
+    CHECK(check::receivedEquals(decoder, data));
+}
+
+// Длительность округляется до тика и насыщается; чужие длительности и переполнение отвергаются
+TEST(packed_buffers_limits)
+{
+    PackedSignalBuffer<4> packed(100);
+    CHECK(packed.push_back({LightLevel::Red, 149}));
+    CHECK(packed.push_back({LightLevel::Blue, 150}));
+    CHECK(packed.push_back({LightLevel::Green, 1000000}));
+    CHECK(packed.push_back({LightLevel::Off, 0}));
+    CHECK(!packed.push_back({LightLevel::White, 100}));
+    CHECK_EQ(packed[0].duration, 100);
+    CHECK_EQ(packed[1].duration, 200);
+    CHECK_EQ(packed[2].duration, PackedSignalBuffer<4>::kMaxTicks * 100L);
+    CHECK(packed[2].value == LightLevel::Green);
+    SignalChange tail[10];
+    CHECK_EQ(packed.copyTo(3, 10, tail), 1);
+    CHECK_EQ(packed.copyTo(4, 10, tail), 0);
+
+    LevelSignalBuffer<3> levels(125);
+    CHECK(!levels.push_back({LightLevel::Red, 126}));
+    CHECK(levels.push_back({LightLevel::Red, 125}));
+    CHECK(levels.push_back({LightLevel::Blue, 125}));
+    CHECK(levels.push_back({LightLevel::White, 125}));
+    CHECK(!levels.push_back({LightLevel::Green, 125}));
+    CHECK(levels[0].value == LightLevel::Red);
+    CHECK(levels[1].value == LightLevel::Blue);
+    CHECK(levels[2].value == LightLevel::White);
+}
+
+// Округление не переводит переход через порог глитчей: 61 при тике 125 и пороге 60
+// остаётся переходом (1 тик), 59 - глитчем (0 тиков), как у декодера до упаковки
+TEST(packed_buffer_keeps_glitch_threshold)
+{
+    PackedSignalBuffer<6> packed(125, 60);
+    for (long duration : {59L, 60L, 61L, 62L, 63L, 187L})
+        CHECK(packed.push_back({LightLevel::Red, duration}));
+    const long expected[] = {0, 125, 125, 125, 125, 125};
+    for (std::size_t i = 0; i < packed.size(); ++i)
+        CHECK_EQ(packed[i].duration, expected[i]);
+
+    // порог выше половины тика: 170 при пороге 180 - глитч, хотя ближайшее - 200
+    PackedSignalBuffer<2> high(100, 180);
+    CHECK(high.push_back({LightLevel::Red, 170}));
+    CHECK(high.push_back({LightLevel::Red, 181}));
+    CHECK_EQ(high[0].duration, 100);
+    CHECK_EQ(high[1].duration, 200);
+
+    // те же переходы через декодер до и после упаковки
+    const std::vector<SignalChange> symbols = {{LightLevel::Red, 61}, {LightLevel::Green, 30}, {LightLevel::Blue, 62},
+                                               {LightLevel::White, 59}, {LightLevel::Red, 240}};
+    PackedSignalBuffer<8> buffer;
+    for (const SignalChange &sc : symbols)
+        buffer.push_back(sc);
+    for (std::size_t i = 0; i < symbols.size(); ++i)
+        CHECK_EQ(buffer[i].duration >= 60, symbols[i].duration >= 60);
+}
@@ -0,0 +1,76 @@
+#include "check.h"
+
+#include "datapacklib_c.h"
+
+namespace
+{
+    void defaultConfig(datapack_config &config, uint8_t flags = 0)
+    {
+        datapack_config_default(&config);
+        config.flags = flags;
+    }
+}
+
+// Путь, который проходит WebAssembly-обёртка: encode парами -> feed пачкой -> данные
+TEST(c_abi_loopback)
+{
+    CHECK_EQ(datapack_abi_version(), DATAPACK_C_ABI_VERSION);
+    datapack_config config;
+    defaultConfig(config, DATAPACK_FRAME_SYNC | DATAPACK_LENGTH_PACKET);
+    datapack_encoder *encoder = datapack_encoder_create(&config);
+    datapack_decoder *decoder = datapack_decoder_create(&config);
+    CHECK(encoder && decoder);
+
+    const std::vector<uint8_t> data = check::pattern(51, 21);
+    std::vector<int32_t> pairs(2 * datapack_max_transitions());
+    const size_t count = datapack_encode(encoder, data.data(), data.size(), pairs.data(), datapack_max_transitions());
+    CHECK_EQ(count, ((data.size() + 1) / 2 + 1) * datapack::kSymbolsPerPacket);
+    CHECK_EQ(pairs[1], config.duration);
+
+    std::vector<uint32_t> packets(count);
+    const size_t found = datapack_decoder_feed(decoder, pairs.data(), count, packets.data(), packets.size());
+    CHECK_EQ(found, (data.size() + 1) / 2);
+    CHECK_EQ(packets[1] >> 16 & 0xFF, 1);
+    CHECK_EQ(packets[1] & 0xFFFF, data[2] | data[3] << 8);
+    CHECK(datapack_decoder_complete(decoder));
+    CHECK_EQ(datapack_decoder_message_length(decoder), data.size());
+    CHECK_EQ(datapack_decoder_received_count(decoder), (data.size() + 1) / 2);
+    CHECK(datapack_decoder_is_received(decoder, 25));
+    CHECK(!datapack_decoder_is_received(decoder, 26));
+
+    std::vector<uint8_t> received(datapack_max_message());
+    CHECK_EQ(datapack_decoder_received_data(decoder, received.data(), received.size()), data.size());
+    CHECK(std::memcmp(received.data(), data.data(), data.size()) == 0);
+    std::vector<uint16_t> words(datapack_max_message() / 2);
+    datapack_decoder_received_words(decoder, words.data());
+    CHECK_EQ(words[0], data[0] | data[1] << 8);
+
+    datapack_decoder_reset(decoder);
+    CHECK_EQ(datapack_decoder_received_count(decoder), 0);
+    datapack_encoder_destroy(encoder);
+    datapack_decoder_destroy(decoder);
+}
+
+// Переполнение: сообщение больше буфера или переходов больше max_transitions - 0;
+// пакетов больше max_packets - копируются первые, возвращается общее число
+TEST(c_abi_limits)
+{
+    datapack_encoder *encoder = datapack_encoder_create(nullptr);
+    datapack_decoder *decoder = datapack_decoder_create(nullptr);
+    const std::vector<uint8_t> big = check::pattern(datapack_max_message() + 2, 22);
+    std::vector<int32_t> pairs(2 * datapack_max_transitions());
+    CHECK_EQ(datapack_encode(encoder, big.data(), big.size(), pairs.data(), datapack_max_transitions()), 0);
+    const std::vector<uint8_t> data = check::pattern(20, 23);
+    CHECK_EQ(datapack_encode(encoder, data.data(), data.size(), pairs.data(), 10), 0);
+
+    datapack_config config;
+    defaultConfig(config, DATAPACK_FRAME_SYNC);
+    datapack_encoder_set_config(encoder, &config);
+    datapack_decoder_set_config(decoder, &config);
+    const size_t count = datapack_encode(encoder, data.data(), data.size(), pairs.data(), datapack_max_transitions());
+    uint32_t packets[3];
+    CHECK_EQ(datapack_decoder_feed(decoder, pairs.data(), count, packets, 3), 10);
+    CHECK_EQ(packets[2] >> 16 & 0xFF, 2);
+    datapack_encoder_destroy(encoder);
+    datapack_decoder_destroy(decoder);
+}
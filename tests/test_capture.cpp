@@ -0,0 +1,161 @@
+#include "check.h"
+
+#include "datapacklib_host.h"
+
+#include <filesystem>
+#include <string>
+
+using namespace datapack;
+
+namespace
+{
+    std::string capturePath(const char *name)
+    {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    bool sameConfig(const ProtocolConfig &a, const ProtocolConfig &b)
+    {
+        return a.modulation == b.modulation && a.min_duration == b.min_duration && a.duration == b.duration &&
+               a.segmented == b.segmented && a.frame_sync == b.frame_sync && a.run_length == b.run_length &&
+               a.length_packet == b.length_packet && a.clock_recovery == b.clock_recovery &&
+               a.fec_group == b.fec_group && a.fec_depth == b.fec_depth;
+    }
+}
+
+// Raw32 хранит переходы и настройки без потерь; replay декодирует запись пачками
+TEST(capture_raw_round_trip)
+{
+    ProtocolConfig config;
+    config.frame_sync = true;
+    config.length_packet = true;
+    const std::vector<uint8_t> data = check::pattern(512, 14);
+    std::vector<SignalChange> symbols = check::encoded(Encoder(config), data);
+    symbols[3].duration = 1234567;
+    const std::string path = capturePath("datapack_capture_raw.bin");
+
+    CaptureWriter writer;
+    CHECK(writer.open(path.c_str(), config));
+    CHECK(writer.write(symbols.data(), 100));
+    for (std::size_t i = 100; i < symbols.size(); ++i)
+        CHECK(writer.write(symbols[i]));
+    CHECK_EQ(writer.size(), symbols.size());
+    CHECK(writer.close());
+
+    CaptureReader reader;
+    CHECK(reader.open(path.c_str()));
+    CHECK(reader.format() == CaptureFormat::Raw32);
+    CHECK(sameConfig(reader.config(), config));
+    CHECK_EQ(reader.size(), symbols.size());
+    std::vector<SignalChange> back(reader.size());
+    CHECK_EQ(reader.read(0, back.size() + 10, back.data()), symbols.size());
+    CHECK(check::sameSymbols(back.data(), symbols.data(), symbols.size()));
+    CHECK(reader[3].duration == 1234567);
+    CHECK_EQ(reader.read(symbols.size(), 1, back.data()), 0);
+
+    // больше kReplayBlock переходов - несколько вызовов feed
+    CHECK(symbols.size() > CaptureReader::kReplayBlock);
+    Decoder decoder(nullptr, nullptr, reader.config());
+    CHECK(reader.replay(decoder) >= data.size() / 2);
+    CHECK(check::receivedEquals(decoder, data));
+    reader.close();
+    std::filesystem::remove(path);
+}
+
+// Packed16 округляет длительность до тика и хранит 16 бит на переход
+TEST(capture_packed_rounds_to_tick)
+{
+    const std::vector<SignalChange> symbols = {{LightLevel::Red, 125}, {LightLevel::Green, 130}, {LightLevel::Blue, 260},
+                                               {LightLevel::White, 40}, {LightLevel::Off, 100000000}};
+    const std::string path = capturePath("datapack_capture_packed.bin");
+    CaptureWriter writer;
+    CHECK(writer.open(path.c_str(), ProtocolConfig(), CaptureFormat::Packed16));
+    CHECK(writer.write(symbols.data(), symbols.size()));
+    CHECK(writer.close());
+    CHECK_EQ(std::filesystem::file_size(path), kCaptureHeaderSize + 2 * symbols.size());
+
+    CaptureReader reader;
+    CHECK(reader.open(path.c_str()));
+    CHECK(reader.format() == CaptureFormat::Packed16);
+    CHECK_EQ(reader.tick(), 125);
+    const long expected[] = {125, 125, 250, 0, 0x07FF * 125};
+    for (std::size_t i = 0; i < symbols.size(); ++i)
+    {
+        CHECK(reader[i].value == symbols[i].value);
+        CHECK_EQ(reader[i].duration, expected[i]);
+    }
+    reader.close();
+    std::filesystem::remove(path);
+}
+
+// Округление Packed16 не переводит переход через min_duration: 61 мкс остаётся символом,
+// 59 мкс - глитчем, и запись разбирается так же, как Raw32
+TEST(capture_packed_keeps_glitch_threshold)
+{
+    ProtocolConfig config;
+    config.frame_sync = true;
+    const auto data = check::pattern(64, 17);
+    std::vector<SignalChange> symbols;
+    for (SignalChange sc : check::encoded(Encoder(config), data))
+    {
+        sc.duration = config.min_duration + 1;
+        symbols.push_back(sc);
+        symbols.push_back({LightLevel::White, config.min_duration - 1});
+        symbols.push_back({sc.value, config.min_duration + 2});
+    }
+
+    const CaptureFormat formats[] = {CaptureFormat::Raw32, CaptureFormat::Packed16};
+    for (CaptureFormat format : formats)
+    {
+        const std::string path = capturePath("datapack_capture_threshold.bin");
+        CaptureWriter writer;
+        CHECK(writer.open(path.c_str(), config, format));
+        CHECK(writer.write(symbols.data(), symbols.size()));
+        CHECK(writer.close());
+
+        CaptureReader reader;
+        CHECK(reader.open(path.c_str()));
+        if (format == CaptureFormat::Packed16)
+        {
+            CHECK_EQ(reader[0].duration, 125);
+            CHECK_EQ(reader[1].duration, 0);
+            CHECK_EQ(reader[2].duration, 125);
+        }
+        Decoder decoder(nullptr, nullptr, reader.config());
+        reader.replay(decoder);
+        CHECK(check::receivedEquals(decoder, data));
+        reader.close();
+        std::filesystem::remove(path);
+    }
+}
+
+// Оборванная запись читается до последней целой записи; чужой файл не открывается
+TEST(capture_truncated_and_foreign_files)
+{
+    const auto symbols = check::encoded(Encoder(), check::pattern(40, 15));
+    const std::string path = capturePath("datapack_capture_cut.bin");
+    CaptureWriter writer;
+    CHECK(writer.open(path.c_str(), ProtocolConfig()));
+    CHECK(writer.write(symbols.data(), symbols.size()));
+    CHECK(writer.close());
+    std::filesystem::resize_file(path, kCaptureHeaderSize + 4 * 50 + 3);
+
+    CaptureReader reader;
+    CHECK(reader.open(path.c_str()));
+    CHECK_EQ(reader.size(), 50);
+    CHECK(reader.read(0, 50, std::vector<SignalChange>(50).data()) == 50);
+    reader.close();
+
+    std::filesystem::resize_file(path, kCaptureHeaderSize - 1);
+    CHECK(!reader.open(path.c_str()));
+    {
+        std::FILE *file = std::fopen(path.c_str(), "wb");
+        const uint8_t junk[kCaptureHeaderSize] = {'N', 'O', 'P', 'E'};
+        std::fwrite(junk, 1, sizeof(junk), file);
+        std::fclose(file);
+    }
+    CHECK(!reader.open(path.c_str()));
+    CHECK(!reader.isOpen());
+    std::filesystem::remove(path);
+    CHECK(!reader.open(path.c_str()));
+}
@@ -0,0 +1,111 @@
+#include "check.h"
+
+#include "datapacklib_host.h"
+
+using namespace datapack;
+
+namespace
+{
+    std::vector<SignalChange> through(const ChannelParams &params, const std::vector<SignalChange> &symbols)
+    {
+        ChannelModel model(params);
+        std::vector<SignalChange> out;
+        auto sink = [&](const SignalChange &sc) { out.push_back(sc); };
+        model.transmit(symbols.data(), symbols.size(), sink);
+        model.flush(sink);
+        return out;
+    }
+}
+
+// Одинаковый seed - одинаковый выход; без искажений канал прозрачен
+TEST(channel_is_deterministic)
+{
+    const auto symbols = check::encoded(Encoder(), check::pattern(200, 3));
+    CHECK(check::sameSymbols(through(ChannelParams(), symbols).data(), symbols.data(), symbols.size()));
+
+    ChannelParams params;
+    params.drop = 0.05;
+    params.duplicate = 0.05;
+    params.glitch = 0.05;
+    params.confusion = 0.05;
+    params.jitter = 0.2;
+    const auto a = through(params, symbols);
+    const auto b = through(params, symbols);
+    CHECK_EQ(a.size(), b.size());
+    CHECK(a.size() == b.size() && check::sameSymbols(a.data(), b.data(), a.size()));
+    params.seed = 2;
+    const auto c = through(params, symbols);
+    CHECK(c.size() != a.size() || !check::sameSymbols(a.data(), c.data(), a.size()));
+}
+
+// Перепутанный уровень Intensity4 остаётся в алфавите профиля и соседствует с
+// исходным: тот же цвет на соседней ступени или другой цвет на той же ступени
+TEST(channel_confuses_intensity_neighbours)
+{
+    ProtocolConfig config;
+    config.modulation = Modulation::Intensity4;
+    const auto symbols = check::encoded(Encoder(config), check::pattern(200, 4));
+    ChannelParams params;
+    params.confusion = 1;
+    params.modulation = Modulation::Intensity4;
+    const auto out = through(params, symbols);
+    CHECK_EQ(out.size(), symbols.size());
+    bool dimmer = false;
+    bool recoloured = false;
+    for (std::size_t i = 0; i < out.size() && i < symbols.size(); ++i)
+    {
+        const LightLevel sent = symbols[i].value;
+        const LightLevel got = out[i].value;
+        CHECK(got != sent);
+        CHECK(static_cast<std::size_t>(got) < kIntensityLevelCount);
+        if (sent == LightLevel::Off || got == LightLevel::Off)
+        {
+            CHECK_EQ(intensityStep(sent == LightLevel::Off ? got : sent), kIntensitySteps - 1);
+            continue;
+        }
+        const int steps = intensityStep(got) - intensityStep(sent);
+        if (baseColour(got) == baseColour(sent))
+        {
+            CHECK(steps == 1 || steps == -1);
+            dimmer |= steps == 1;
+        }
+        else
+        {
+            CHECK_EQ(steps, 0);
+            recoloured = true;
+        }
+    }
+    CHECK(dimmer && recoloured);
+
+    // в Classic путаница по-прежнему среди пяти уровней
+    params.modulation = Modulation::Classic;
+    for (const SignalChange &sc : through(params, check::encoded(Encoder(), check::pattern(200, 4))))
+        CHECK(static_cast<std::size_t>(sc.value) < 5);
+}
+
+// simulateLink: чистый канал доставляет всё (frame_sync - без ложных совпадений CRC
+// на невыровненных окнах); потери и помехи портят часть сообщений, но CRC отсекает
+// почти все ошибки
+TEST(channel_simulate_link)
+{
+    for (Modulation modulation : {Modulation::Classic, Modulation::Intensity4})
+    {
+        ProtocolConfig config;
+        config.modulation = modulation;
+        config.frame_sync = true;
+        const LinkStats clean = simulateLink(config, ChannelParams(), 20, 64);
+        CHECK_EQ(clean.messages, 20);
+        CHECK_EQ(clean.intact, 20);
+        CHECK_EQ(clean.words_ok, clean.words);
+        CHECK(clean.goodput(64) > 0);
+
+        ChannelParams params;
+        params.drop = 0.01;
+        params.confusion = 0.01;
+        params.glitch = 0.01;
+        const LinkStats noisy = simulateLink(config, params, 50, 64);
+        CHECK(noisy.intact < noisy.messages);
+        CHECK(noisy.words_ok > noisy.words / 2);
+        CHECK(noisy.words_wrong * 50 < noisy.words);
+    }
+}
@@ -0,0 +1,74 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    // Тик передатчика меняется от начального отклонения start до end (в тысячных)
+    std::vector<SignalChange> drifted(std::vector<SignalChange> symbols, long start, long end)
+    {
+        const long last = symbols.size() > 1 ? static_cast<long>(symbols.size()) - 1 : 1;
+        long i = 0;
+        for (SignalChange &sc : symbols)
+            sc.duration = sc.duration * (1000 + start + (end - start) * i++ / last) / 1000;
+        return symbols;
+    }
+
+    bool decodes(ProtocolConfig config, const std::vector<SignalChange> &symbols, const std::vector<uint8_t> &data,
+                 long *tick = nullptr)
+    {
+        Decoder decoder(nullptr, nullptr, config);
+        decoder.feed(symbols.data(), symbols.size());
+        if (tick)
+            *tick = decoder.tickEstimate();
+        return check::receivedEquals(decoder, data);
+    }
+}
+
+// run_length: на тике, ушедшем на 18 %, без подстройки длины квантуются неверно,
+// с подстройкой сообщение принимается, и оценка тика сходится к настоящему
+TEST(clock_recovery_follows_skew)
+{
+    ProtocolConfig config;
+    config.run_length = true;
+    config.frame_sync = true;
+    const std::vector<uint8_t> data = check::pattern(256, 41);
+    const auto symbols = drifted(check::encoded(Encoder(config), data), 180, 180);
+    CHECK(!decodes(config, symbols, data));
+
+    config.clock_recovery = true;
+    long tick = 0;
+    CHECK(decodes(config, symbols, data, &tick));
+    CHECK(tick > 125 * 1150 / 1000 && tick < 125 * 1210 / 1000);
+}
+
+// Тик плавно уходит на 20 % за сообщение в обе стороны
+TEST(clock_recovery_follows_drift)
+{
+    ProtocolConfig config;
+    config.run_length = true;
+    config.frame_sync = true;
+    config.clock_recovery = true;
+    const std::vector<uint8_t> data = check::pattern(400, 42);
+    const auto symbols = check::encoded(Encoder(config), data);
+    long tick = 0;
+    CHECK(decodes(config, drifted(symbols, 0, 200), data, &tick));
+    CHECK(tick > 125 * 1150 / 1000);
+    CHECK(decodes(config, drifted(symbols, 0, -200), data, &tick));
+    CHECK(tick < 125 * 850 / 1000);
+}
+
+// Порог глитчей держит отношение min_duration / duration к оценке тика
+TEST(clock_recovery_scales_glitch_threshold)
+{
+    ProtocolConfig config;
+    config.clock_recovery = true;
+    config.frame_sync = true;
+    const auto symbols = drifted(check::encoded(Encoder(config), check::pattern(100, 43)), -200, -200);
+    Decoder decoder(nullptr, nullptr, config);
+    CHECK_EQ(decoder.glitchThreshold(), config.min_duration);
+    decoder.feed(symbols.data(), symbols.size());
+    const long expected = decoder.tickEstimate() * config.min_duration / config.duration;
+    CHECK(decoder.glitchThreshold() >= expected - 1 && decoder.glitchThreshold() <= expected + 1);
+    CHECK(decoder.glitchThreshold() < config.min_duration);
+}
@@ -0,0 +1,96 @@
+#include "check.h"
+
+using namespace datapack;
+
+// Таблицы ди-битов: уровень, выбранный кодером, декодируется в тот же ди-бит
+TEST(dbit_tables_round_trip)
+{
+    for (LightLevel prev : levels)
+    {
+        for (uint8_t dbit = 0; dbit < 4; ++dbit)
+        {
+            const LightLevel next = getLightForDbit(prev, dbit);
+            CHECK(next != prev);
+            CHECK_EQ(getDbit(prev, next), dbit);
+        }
+    }
+}
+
+// Каждое слово сообщения доходит до декодера. Без frame_sync ложные совпадения
+// CRC на невыровненных окнах выдают и лишние пакеты, поэтому проверяется, что
+// среди выданных есть верный пакет каждого индекса.
+TEST(loopback_plain_message)
+{
+    const std::vector<uint8_t> data = check::pattern(41);
+    const auto symbols = check::encoded(Encoder(), data);
+    const std::size_t words = (data.size() + 1) / 2;
+    CHECK_EQ(symbols.size(), words * kSymbolsPerPacket);
+
+    Decoder decoder;
+    std::vector<UnpackedPackage> packets(symbols.size());
+    packets.resize(decoder.feed(symbols.data(), symbols.size(), packets.data(), packets.size()));
+    for (std::size_t i = 0; i < words; ++i)
+    {
+        const uint16_t word = static_cast<uint16_t>(data[2 * i] | (2 * i + 1 < data.size() ? data[2 * i + 1] << 8 : 0));
+        bool seen = false;
+        for (const UnpackedPackage &package : packets)
+            seen |= package.index == i && package.word == word;
+        CHECK(seen);
+    }
+}
+
+namespace
+{
+    // Побитовая CRC-8 (полином 0x07, начальное значение init) - как до табличной версии
+    uint8_t bitwiseCrc(const uint8_t *bytes, std::size_t count, uint8_t init = 0)
+    {
+        uint8_t crc = init;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            crc ^= bytes[i];
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+        }
+        return crc;
+    }
+}
+
+// Табличная CRC совпадает с побитовой для всех индексов и сегментов
+TEST(crc_matches_bitwise_reference)
+{
+    const uint16_t words[] = {0x0000, 0x0001, 0x8000, 0x1234, 0xBEEF, 0xFFFF};
+    for (unsigned index = 0; index < 256; ++index)
+    {
+        for (uint16_t word : words)
+        {
+            const uint8_t bytes[3] = {static_cast<uint8_t>(word & 0xFF), static_cast<uint8_t>(word >> 8),
+                                      static_cast<uint8_t>(index)};
+            CHECK_EQ(crs8(word, static_cast<uint8_t>(index)), bitwiseCrc(bytes, 3));
+            CHECK_EQ(crs8(word, static_cast<uint8_t>(index), 5), bitwiseCrc(bytes, 3, 5));
+        }
+    }
+    const uint32_t packet = 0x07u << 24 | 0x34u << 16 | 0x12u << 8 | crs8(0x1234, 7);
+    CHECK(unpack_and_check(packet).valid);
+    CHECK(!unpack_and_check(packet ^ 0x100).valid);
+}
+
+// Байт за один поиск в таблице - те же четыре перехода, что по ди-битам
+TEST(byte_table_matches_dbit_chain)
+{
+    for (LightLevel prev : levels)
+    {
+        for (unsigned byte = 0; byte < 256; ++byte)
+        {
+            SignalChange out[4];
+            const LightLevel last = encodeByte(prev, static_cast<uint8_t>(byte), 125, out);
+            LightLevel level = prev;
+            for (int k = 0; k < 4; ++k)
+            {
+                level = getLightForDbit(level, static_cast<uint8_t>((byte >> (6 - 2 * k)) & 0x03));
+                CHECK(out[k].value == level);
+                CHECK_EQ(out[k].duration, 125);
+            }
+            CHECK(last == level);
+        }
+    }
+}
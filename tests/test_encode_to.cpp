@@ -0,0 +1,70 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    std::vector<SignalChange> encodedTo(const Encoder &encoder, const std::vector<uint8_t> &data, bool *ok = nullptr)
+    {
+        std::vector<SignalChange> symbols;
+        const bool done =
+            encoder.encodeTo(data.data(), data.size(), [&](const SignalChange &sc) { symbols.push_back(sc); });
+        if (ok)
+            *ok = done;
+        return symbols;
+    }
+}
+
+// encodeTo выдаёт те же символы, что encode: с чётностью FEC и служебным пакетом длины
+TEST(encode_to_matches_encode)
+{
+    ProtocolConfig configs[4];
+    configs[1].length_packet = true;
+    configs[2].fec_group = 4;
+    configs[3].fec_group = 4;
+    configs[3].length_packet = true;
+    for (const ProtocolConfig &config : configs)
+    {
+        const Encoder encoder(config);
+        for (std::size_t len : {0, 1, 2, 41, 200})
+        {
+            const std::vector<uint8_t> data = check::pattern(len, 5);
+            const auto expected = check::encoded(encoder, data);
+            LightLevel last = LightLevel::Off;
+            std::vector<SignalChange> symbols;
+            const bool ok = encoder.encodeTo(
+                data.data(), data.size(), [&](const SignalChange &sc) { symbols.push_back(sc); }, &last);
+            CHECK(ok);
+            CHECK_EQ(symbols.size(), expected.size());
+            CHECK(symbols.size() == expected.size() &&
+                  check::sameSymbols(symbols.data(), expected.data(), symbols.size()));
+            if (!symbols.empty())
+                CHECK(last == symbols.back().value);
+        }
+    }
+}
+
+// Сообщение, которое encode отверг бы, encodeTo тоже отвергает и ничего не выдаёт
+TEST(encode_to_rejects_oversized)
+{
+    ProtocolConfig fec;
+    fec.fec_group = 4;
+    const std::size_t capacity = fecDataCapacity(fec.fec_group, fec.fec_depth, kMaxWords) * 2;
+    bool ok = true;
+    CHECK(encodedTo(Encoder(fec), check::pattern(capacity + 1), &ok).empty());
+    CHECK(!ok);
+    CHECK(!encodedTo(Encoder(fec), check::pattern(capacity), &ok).empty());
+    CHECK(ok);
+
+    ProtocolConfig length;
+    length.length_packet = true;
+    CHECK(encodedTo(Encoder(length), check::pattern(kMaxWords * 2 + 1), &ok).empty());
+    CHECK(!ok);
+    CHECK(!encodedTo(Encoder(length), check::pattern(kMaxWords * 2), &ok).empty());
+    CHECK(ok);
+
+    // без FEC и пакета длины длина не ограничена - нумерация сегментами
+    const auto symbols = encodedTo(Encoder(), check::pattern(1001), &ok);
+    CHECK(ok);
+    CHECK_EQ(symbols.size(), 501 * kSymbolsPerPacket);
+}
@@ -0,0 +1,103 @@
+#include "check.h"
+
+#include <algorithm>
+
+using namespace datapack;
+
+namespace
+{
+    constexpr std::size_t kGroup = 4;
+    constexpr std::size_t kDepth = 4;
+
+    ProtocolConfig fecConfig()
+    {
+        ProtocolConfig config;
+        config.fec_group = kGroup;
+        config.fec_depth = kDepth;
+        config.frame_sync = true;
+        config.length_packet = true;
+        return config;
+    }
+
+    // Передача сообщения без пакетов lost: оставшиеся идут подряд, цепочка уровней не рвётся
+    Decoder receiveWithout(const std::vector<uint8_t> &data, const std::vector<std::size_t> &lost)
+    {
+        const ProtocolConfig config = fecConfig();
+        const Encoder encoder(config);
+        Encoder::Words words;
+        CHECK(encoder.messageWords(data.data(), data.size(), words));
+        std::vector<uint8_t> indices;
+        for (std::size_t i = 0; i < words.size(); ++i)
+        {
+            if (std::find(lost.begin(), lost.end(), i) == lost.end())
+                indices.push_back(static_cast<uint8_t>(i));
+        }
+        Encoder::Signals out;
+        encoder.encodeSelected(words.data(), words.size(), indices.data(), indices.size(), out);
+        std::vector<SignalChange> symbols(out.data(), out.data() + out.size());
+        SignalChange meta[kSymbolsPerPacket];
+        encodeMetaPacket(symbols.back().value, kMetaLength, static_cast<uint16_t>(data.size()), config, meta);
+        symbols.insert(symbols.end(), meta, meta + kSymbolsPerPacket);
+
+        Decoder decoder(nullptr, nullptr, config);
+        decoder.feed(symbols.data(), symbols.size());
+        return decoder;
+    }
+
+    // Индекс пакета с i-м словом данных группы g блока block
+    std::size_t dataPacket(std::size_t block, std::size_t g, std::size_t i)
+    {
+        return block * fecBlockWords(kGroup, kDepth) + i * kDepth + g;
+    }
+}
+
+// Любые два потерянных слова в каждой группе восстанавливаются
+TEST(fec_recovers_two_erasures_per_group)
+{
+    const std::vector<uint8_t> data = check::pattern(2 * kGroup * kDepth * 2 - 5, 11);
+    std::vector<std::size_t> lost;
+    for (std::size_t block = 0; block < 2; ++block)
+    {
+        for (std::size_t g = 0; g < kDepth; ++g)
+        {
+            lost.push_back(dataPacket(block, g, g % kGroup));
+            lost.push_back(dataPacket(block, g, (g + 1) % kGroup));
+        }
+    }
+    const Decoder decoder = receiveWithout(data, lost);
+    CHECK(decoder.complete());
+    std::size_t unrecovered = 1;
+    uint16_t words[kMaxWords];
+    decoder.recoverFec(words, &unrecovered);
+    CHECK_EQ(unrecovered, 0);
+    CHECK(check::receivedEquals(decoder, data));
+}
+
+// Пачка из 2 * depth пропавших подряд пакетов исправляется благодаря перемежению
+TEST(fec_recovers_interleaved_burst)
+{
+    const std::vector<uint8_t> data = check::pattern(kGroup * kDepth * 2 * 3, 12);
+    for (std::size_t start : {0, 5, 19, 40})
+    {
+        std::vector<std::size_t> lost;
+        for (std::size_t k = 0; k < 2 * kDepth; ++k)
+            lost.push_back(start + k);
+        const Decoder decoder = receiveWithout(data, lost);
+        CHECK(decoder.complete());
+        CHECK(check::receivedEquals(decoder, data));
+    }
+}
+
+// Три потери в одной группе не восстановить: сообщение не собрано, потеря видна
+TEST(fec_reports_unrecoverable_group)
+{
+    const std::vector<uint8_t> data = check::pattern(kGroup * kDepth * 2, 13);
+    const Decoder decoder = receiveWithout(data, {dataPacket(0, 1, 0), dataPacket(0, 1, 1), dataPacket(0, 1, 3)});
+    CHECK(!decoder.complete());
+    CHECK(!decoder.isRecoverable(1 * kDepth + 1));
+    CHECK(decoder.isRecoverable(0));
+    std::size_t unrecovered = 0;
+    uint16_t words[kMaxWords];
+    decoder.recoverFec(words, &unrecovered);
+    CHECK(unrecovered > 0);
+}
@@ -0,0 +1,72 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    void collect(const UnpackedPackage &package, void *context)
+    {
+        static_cast<std::vector<UnpackedPackage> *>(context)->push_back(package);
+    }
+
+    bool samePackets(const std::vector<UnpackedPackage> &a, const std::vector<UnpackedPackage> &b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].index != b[i].index || a[i].word != b[i].word || a[i].segment != b[i].segment)
+                return false;
+        }
+        return true;
+    }
+}
+
+// Пачка переходов даёт те же пакеты и то же состояние, что подача по одному,
+// при любом разбиении на пачки и в любом режиме
+TEST(bulk_feed_matches_per_transition_feed)
+{
+    ProtocolConfig configs[5];
+    configs[1].frame_sync = true;
+    configs[2].run_length = true;
+    configs[3].modulation = Modulation::Intensity4;
+    configs[4].clock_recovery = true;
+    for (const ProtocolConfig &config : configs)
+    {
+        std::vector<SignalChange> symbols;
+        for (uint8_t m = 0; m < 3; ++m)
+        {
+            const auto message = check::encoded(Encoder(config), check::pattern(60, m));
+            symbols.insert(symbols.end(), message.begin(), message.end());
+            symbols.push_back({LightLevel::White, config.min_duration / 2}); // глитч
+        }
+
+        std::vector<UnpackedPackage> single;
+        Decoder one(collect, &single, config);
+        for (const SignalChange &sc : symbols)
+            one.feed(sc);
+
+        for (std::size_t block : {std::size_t(1), std::size_t(7), std::size_t(64), symbols.size()})
+        {
+            std::vector<UnpackedPackage> bulk;
+            Decoder many(collect, &bulk, config);
+            std::vector<UnpackedPackage> out(symbols.size());
+            std::vector<std::size_t> positions(symbols.size());
+            std::size_t returned = 0;
+            for (std::size_t first = 0; first < symbols.size(); first += block)
+            {
+                const std::size_t n = symbols.size() - first < block ? symbols.size() - first : block;
+                const std::size_t found = many.feed(symbols.data() + first, n, out.data() + returned,
+                                                    out.size() - returned, positions.data() + returned);
+                for (std::size_t k = 0; k < found; ++k)
+                    CHECK(positions[returned + k] < n);
+                returned += found;
+            }
+            out.resize(returned);
+            CHECK(samePackets(single, bulk));
+            CHECK(samePackets(single, out));
+            CHECK(std::memcmp(one.receivedWords(), many.receivedWords(), kMaxWords * 2) == 0);
+            CHECK_EQ(one.tickEstimate(), many.tickEstimate());
+        }
+    }
+}
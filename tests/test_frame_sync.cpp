@@ -0,0 +1,113 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    struct Inbox
+    {
+        std::vector<std::vector<uint8_t>> messages;
+    };
+
+    void store(const uint8_t *data, std::size_t len, void *context)
+    {
+        static_cast<Inbox *>(context)->messages.emplace_back(data, data + len);
+    }
+
+    // Переходы между сообщениями: count символов, последний - Off, с которого
+    // начинает следующий вывод Encoder. Сдвигает фазу пакетов на count.
+    void appendGap(std::vector<SignalChange> &symbols, std::size_t count)
+    {
+        LightLevel prev = symbols.empty() ? LightLevel::Off : symbols.back().value;
+        for (std::size_t k = 0; k < count; ++k)
+        {
+            LightLevel next = (count - k) % 2 == 1 ? LightLevel::Off : LightLevel::White;
+            if (next == prev)
+                next = LightLevel::Red; // повтор уровня фильтруется и фазу не сдвигает
+            symbols.push_back({next, 125});
+            prev = next;
+        }
+        if (prev != LightLevel::Off)
+            symbols.push_back({LightLevel::Off, 125});
+    }
+
+    void append(std::vector<SignalChange> &symbols, const std::vector<SignalChange> &more)
+    {
+        symbols.insert(symbols.end(), more.begin(), more.end());
+    }
+}
+
+// Два сообщения подряд со сдвигом фазы между ними: второе принимается целиком
+TEST(frame_sync_back_to_back_with_phase_shift)
+{
+    ProtocolConfig config;
+    config.frame_sync = true;
+    config.length_packet = true;
+    const Encoder encoder(config);
+    for (std::size_t gap = 1; gap <= 5; gap += 2)
+    {
+        const std::vector<uint8_t> first = check::pattern(30, 1);
+        const std::vector<uint8_t> second = check::pattern(17, 2);
+        std::vector<SignalChange> symbols = check::encoded(encoder, first);
+        appendGap(symbols, gap);
+        append(symbols, check::encoded(encoder, second));
+
+        Inbox inbox;
+        uint16_t spare[kMaxWords];
+        Decoder decoder(nullptr, nullptr, config);
+        decoder.setSpareBuffer(spare);
+        decoder.setMessageCallback(store, &inbox);
+        decoder.feed(symbols.data(), symbols.size());
+        CHECK_EQ(inbox.messages.size(), 2);
+        CHECK(inbox.messages.size() == 2 && inbox.messages[0] == first && inbox.messages[1] == second);
+    }
+}
+
+// Лишний или выпавший переход внутри сообщения портит один пакет, а следующие
+// за ним со сдвинутой фазой не теряются
+TEST(frame_sync_tracks_inserted_and_dropped_transition)
+{
+    ProtocolConfig config;
+    config.frame_sync = true;
+    const std::vector<uint8_t> data = check::pattern(40, 3);
+    const auto clean = check::encoded(Encoder(config), data);
+    const std::size_t damaged = 5; // номер испорченного пакета
+    for (int variant = 0; variant < 2; ++variant)
+    {
+        std::vector<SignalChange> symbols(clean.begin(), clean.begin() + damaged * kSymbolsPerPacket + 7);
+        if (variant == 0)
+        {
+            // лишний переход: уровень, отличный от соседей
+            const LightLevel before = symbols.back().value;
+            const LightLevel after = clean[symbols.size()].value;
+            for (LightLevel level : levels)
+            {
+                if (level != before && level != after)
+                {
+                    symbols.push_back({level, 125});
+                    break;
+                }
+            }
+            symbols.insert(symbols.end(), clean.begin() + static_cast<long>(symbols.size()) - 1, clean.end());
+        }
+        else
+        {
+            // выпавший переход: следующий уровень не повторяет предыдущий
+            std::size_t skip = symbols.size();
+            while (clean[skip + 1].value == symbols.back().value)
+                ++skip;
+            symbols.insert(symbols.end(), clean.begin() + static_cast<long>(skip) + 1, clean.end());
+        }
+
+        Decoder decoder(nullptr, nullptr, config);
+        decoder.feed(symbols.data(), symbols.size());
+        CHECK(decoder.locked());
+        for (std::size_t i = 0; i < data.size() / 2; ++i)
+        {
+            if (i == damaged)
+                continue;
+            CHECK(decoder.isReceived(i));
+            CHECK_EQ(decoder.receivedWords()[i], data[2 * i] | data[2 * i + 1] << 8);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#include "check.h"
+
+using namespace datapack;
+
+// Глобальный API прежних версий: setSendData -> send_commands -> feed -> receive_buffer
+TEST(legacy_globals_round_trip)
+{
+    const std::vector<uint8_t> data = check::pattern(12, 4);
+    setSendData(data.data(), data.size());
+    CHECK_EQ(send_buffer.size(), 6);
+    CHECK_EQ(send_commands.size(), 6 * kSymbolsPerPacket);
+
+    for (uint16_t &word : receive_buffer)
+        word = 0;
+    window = 12345678;
+    prev_value = LightLevel::Off;
+    feed(send_commands.data(), send_commands.size());
+    CHECK(prev_value == send_commands[send_commands.size() - 1].value);
+    for (std::size_t i = 0; i < send_buffer.size(); ++i)
+        CHECK_EQ(receive_buffer[i], send_buffer[i]);
+
+    uint8_t received[kMaxWords * 2];
+    CHECK_EQ(getReceivedData(received), kMaxWords * 2);
+    CHECK(std::memcmp(received, data.data(), data.size()) == 0);
+}
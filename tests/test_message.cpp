@@ -0,0 +1,210 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    struct Inbox
+    {
+        std::vector<std::vector<uint8_t>> messages;
+    };
+
+    void store(const uint8_t *data, std::size_t len, void *context)
+    {
+        static_cast<Inbox *>(context)->messages.emplace_back(data, data + len);
+    }
+
+    ProtocolConfig messageConfig()
+    {
+        ProtocolConfig config;
+        config.frame_sync = true;
+        config.length_packet = true;
+        return config;
+    }
+
+    // Символы сообщения без пакетов с индексами из lost (и со служебным пакетом длины).
+    // Цепочка уровней продолжается с prev - уровня, на котором остановилась прошлая передача.
+    std::vector<SignalChange> without(const std::vector<uint8_t> &data, std::vector<uint8_t> lost,
+                                      LightLevel prev = LightLevel::Off)
+    {
+        const Encoder encoder(messageConfig());
+        Encoder::Words words;
+        encoder.messageWords(data.data(), data.size(), words);
+        std::vector<uint8_t> indices;
+        for (std::size_t i = 0; i < words.size(); ++i)
+        {
+            bool skip = false;
+            for (uint8_t index : lost)
+                skip |= index == i;
+            if (!skip)
+                indices.push_back(static_cast<uint8_t>(i));
+        }
+        Encoder::Signals out;
+        encoder.encodeSelected(words.data(), words.size(), indices.data(), indices.size(), out, prev);
+        std::vector<SignalChange> symbols(out.data(), out.data() + out.size());
+        SignalChange meta[kSymbolsPerPacket];
+        encodeMetaPacket(symbols.back().value, kMetaLength, static_cast<uint16_t>(data.size()), messageConfig(), meta);
+        symbols.insert(symbols.end(), meta, meta + kSymbolsPerPacket);
+        return symbols;
+    }
+}
+
+// Сообщение собирается, коллбэк вызывается один раз, повтор его не вызывает снова
+TEST(message_completes_once)
+{
+    const std::vector<uint8_t> data = check::pattern(41, 21);
+    const auto symbols = check::encoded(Encoder(messageConfig()), data);
+    Inbox inbox;
+    Decoder decoder(nullptr, nullptr, messageConfig());
+    decoder.setMessageCallback(store, &inbox);
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(decoder.complete());
+    CHECK_EQ(decoder.messageLength(), data.size());
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK_EQ(inbox.messages.size(), 1);
+    CHECK(inbox.messages.size() == 1 && inbox.messages[0] == data);
+    CHECK(check::receivedEquals(decoder, data));
+}
+
+// Пакет длины другого размера: слова прошлого сообщения не дополняют новое
+TEST(message_length_change_drops_stale_words)
+{
+    const std::vector<uint8_t> first = check::pattern(40, 22);
+    const std::vector<uint8_t> second = check::pattern(24, 23);
+    Inbox inbox;
+    Decoder decoder(nullptr, nullptr, messageConfig());
+    decoder.setMessageCallback(store, &inbox);
+
+    // первое сообщение принято не полностью, у второго пропало слово 3
+    auto symbols = without(first, {7});
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(!decoder.complete());
+    symbols = without(second, {3}, symbols.back().value);
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(!decoder.complete());
+    CHECK(!decoder.isReceived(3));
+    CHECK_EQ(decoder.receivedCount(), (second.size() + 1) / 2 - 1);
+    CHECK(inbox.messages.empty());
+
+    // повтор второго сообщения его досылает
+    symbols = without(second, {}, symbols.back().value);
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(decoder.complete());
+    CHECK_EQ(inbox.messages.size(), 1);
+    CHECK(inbox.messages.size() == 1 && inbox.messages[0] == second);
+
+    // после собранного сообщения следующие собираются без reset - и другой длины, и той же
+    const std::vector<uint8_t> third = check::pattern(60, 24);
+    const std::vector<uint8_t> fourth = check::pattern(60, 25);
+    symbols = without(third, {}, symbols.back().value);
+    decoder.feed(symbols.data(), symbols.size());
+    symbols = without(fourth, {}, symbols.back().value);
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(decoder.complete());
+    CHECK_EQ(inbox.messages.size(), 3);
+    CHECK(inbox.messages.size() == 3 && inbox.messages[1] == third && inbox.messages[2] == fourth);
+}
+
+// Без frame_sync другое слово на принятом индексе может быть ложным совпадением CRC:
+// карта приёма из-за него не сбрасывается, новое сообщение узнаётся по длине
+TEST(message_without_frame_sync_changes_only_by_length)
+{
+    ProtocolConfig plain = messageConfig();
+    plain.frame_sync = false;
+    const std::vector<uint8_t> first = check::pattern(40, 29);
+    const std::vector<uint8_t> second = check::pattern(24, 30);
+    Inbox inbox;
+    Decoder decoder(nullptr, nullptr, plain);
+    decoder.setMessageCallback(store, &inbox);
+
+    auto symbols = without(first, {5});
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(!decoder.complete());
+
+    // чужое слово с индексом 2, затем верное слово 2 и пропущенное 5
+    const Encoder encoder(plain);
+    Encoder::Words words;
+    CHECK(encoder.messageWords(first.data(), first.size(), words));
+    words[2] ^= 0x5A5A;
+    const uint8_t foreign[] = {2};
+    Encoder::Signals out;
+    encoder.encodeSelected(words.data(), words.size(), foreign, 1, out, symbols.back().value);
+    symbols.assign(out.data(), out.data() + out.size());
+    words[2] ^= 0x5A5A;
+    const uint8_t repair[] = {2, 5};
+    encoder.encodeSelected(words.data(), words.size(), repair, 2, out, symbols.back().value);
+    symbols.insert(symbols.end(), out.data(), out.data() + out.size());
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(decoder.complete());
+    CHECK(inbox.messages.size() == 1 && inbox.messages[0] == first);
+
+    symbols = without(second, {}, symbols.back().value);
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK_EQ(inbox.messages.size(), 2);
+    CHECK(inbox.messages.size() == 2 && inbox.messages[1] == second);
+}
+
+#if DATAPACK_LITTLE_ENDIAN
+namespace
+{
+    struct ViewCheck
+    {
+        const Decoder *decoder;
+        std::vector<std::vector<uint8_t>> messages;
+        bool viewMatches = true;
+    };
+
+    // В коллбэке messageView уже указывает на собранное сообщение
+    void storeView(const uint8_t *data, std::size_t len, void *context)
+    {
+        ViewCheck &views = *static_cast<ViewCheck *>(context);
+        const ByteView view = views.decoder->messageView();
+        views.viewMatches &= view.data == data && view.size == len;
+        views.messages.emplace_back(data, data + len);
+    }
+}
+
+// receivedView - принятый без пропусков префикс прямо из буфера приёма
+TEST(received_view_is_prefix)
+{
+    const std::vector<uint8_t> data = check::pattern(40, 26);
+    Decoder decoder(nullptr, nullptr, messageConfig());
+    const auto symbols = without(data, {6});
+    decoder.feed(symbols.data(), symbols.size());
+    const ByteView view = decoder.receivedView();
+    CHECK(view.data == reinterpret_cast<const uint8_t *>(decoder.receivedWords()));
+    CHECK_EQ(view.size, 12);
+    CHECK(std::memcmp(view.data, data.data(), view.size) == 0);
+    CHECK(decoder.messageView().data == nullptr);
+}
+
+// Двойная буферизация: собранное сообщение остаётся на месте, пока принимается следующее
+TEST(spare_buffer_keeps_message_while_receiving)
+{
+    uint16_t spare[kMaxWords];
+    Decoder decoder(nullptr, nullptr, messageConfig());
+    ViewCheck views{&decoder, {}};
+    decoder.setSpareBuffer(spare);
+    decoder.setMessageCallback(storeView, &views);
+
+    const std::vector<uint8_t> first = check::pattern(50, 27);
+    const std::vector<uint8_t> second = check::pattern(31, 28);
+    auto symbols = without(first, {});
+    decoder.feed(symbols.data(), symbols.size());
+    const ByteView held = decoder.messageView();
+    CHECK(held.size == first.size() && std::memcmp(held.data, first.data(), held.size) == 0);
+
+    // половина второго сообщения не трогает первое
+    const auto next = without(second, {}, symbols.back().value);
+    decoder.feed(next.data(), next.size() / 2);
+    CHECK(std::memcmp(held.data, first.data(), first.size()) == 0);
+    decoder.feed(next.data() + next.size() / 2, next.size() - next.size() / 2);
+
+    CHECK_EQ(views.messages.size(), 2);
+    CHECK(views.viewMatches);
+    CHECK(views.messages.size() == 2 && views.messages[0] == first && views.messages[1] == second);
+    const ByteView latest = decoder.messageView();
+    CHECK(latest.data != held.data);
+    CHECK(latest.size == second.size() && std::memcmp(latest.data, second.data(), latest.size) == 0);
+}
+#endif
@@ -0,0 +1,118 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    // Длительности символов дрожат в пределах ±percent% (детерминированно)
+    std::vector<SignalChange> jittered(std::vector<SignalChange> symbols, long percent)
+    {
+        uint32_t x = 12345;
+        for (SignalChange &sc : symbols)
+        {
+            x = x * 1664525u + 1013904223u;
+            const long offset = static_cast<long>(x >> 8) % (2 * percent + 1) - percent;
+            sc.duration += sc.duration * offset / 100;
+        }
+        return symbols;
+    }
+
+    // Сообщение принято целиком через frame_sync с дрожанием длительности
+    void checkLoopback(const ProtocolConfig &config, std::size_t len, long percent)
+    {
+        const std::vector<uint8_t> data = check::pattern(len, static_cast<uint8_t>(len));
+        const auto symbols = jittered(check::encoded(Encoder(config), data), percent);
+        CHECK_EQ(symbols.size(), (len + 1) / 2 * symbolsPerPacket(config));
+        Decoder decoder(nullptr, nullptr, config);
+        decoder.feed(symbols.data(), symbols.size());
+        CHECK(check::receivedEquals(decoder, data));
+    }
+}
+
+// run_length: пакет - 8 переходов, длительность несёт два бита, ±10% дрожания не мешают
+TEST(run_length_loopback)
+{
+    ProtocolConfig config;
+    config.run_length = true;
+    config.frame_sync = true;
+    CHECK_EQ(symbolsPerPacket(config), kSymbolsPerPacket / 2);
+    for (std::size_t len : {4, 34, 200, 512})
+        checkLoopback(config, len, 10);
+
+    // длительности - от 1 до 4 тиков
+    for (const SignalChange &sc : check::encoded(Encoder(config), check::pattern(64)))
+        CHECK(sc.duration % config.duration == 0 && sc.duration >= config.duration &&
+              sc.duration <= 4 * config.duration);
+
+    // потоковый кодер выдаёт то же, что Encoder
+    const std::vector<uint8_t> data = check::pattern(100, 7);
+    StreamEncoder stream(config);
+    stream.start(data.data(), data.size());
+    std::vector<SignalChange> streamed;
+    SignalChange out[32];
+    while (std::size_t n = stream.next(out, 32))
+        streamed.insert(streamed.end(), out, out + n);
+    const auto expected = check::encoded(Encoder(config), data);
+    CHECK(streamed.size() == expected.size() && check::sameSymbols(streamed.data(), expected.data(), expected.size()));
+}
+
+// Intensity4: таблицы символов обратимы, уровни ступеней сводятся к своему цвету
+TEST(intensity_tables_round_trip)
+{
+    for (std::size_t p = 0; p < kIntensityLevelCount; ++p)
+    {
+        const LightLevel prev = static_cast<LightLevel>(p);
+        for (uint8_t digit = 0; digit < 16; ++digit)
+        {
+            const LightLevel next = getLightForIntensityDigit(prev, digit);
+            CHECK(next != prev);
+            CHECK(static_cast<std::size_t>(next) < kIntensityLevelCount);
+            CHECK_EQ(getIntensityDigit(prev, next), digit);
+        }
+    }
+    for (LightLevel colour : {LightLevel::White, LightLevel::Red, LightLevel::Green, LightLevel::Blue})
+    {
+        for (uint8_t step = 0; step < kIntensitySteps; ++step)
+        {
+            CHECK(baseColour(makeLevel(colour, step)) == colour);
+            CHECK_EQ(intensityStep(makeLevel(colour, step)), step);
+        }
+    }
+}
+
+// Intensity4: 8 переходов на пакет; Encoder, encodeTo и StreamEncoder совпадают,
+// а длительность (в том числе с run_length) данных не несёт
+TEST(intensity_loopback)
+{
+    ProtocolConfig config;
+    config.modulation = Modulation::Intensity4;
+    config.frame_sync = true;
+    CHECK_EQ(symbolsPerPacket(config), kSymbolsPerPacket / 2);
+    for (std::size_t len : {4, 34, 200, 512})
+        checkLoopback(config, len, 10);
+
+    const std::vector<uint8_t> data = check::pattern(150, 9);
+    const auto expected = check::encoded(Encoder(config), data);
+    bool highLevel = false;
+    for (const SignalChange &sc : expected)
+    {
+        CHECK_EQ(sc.duration, config.duration);
+        highLevel |= static_cast<int>(sc.value) > static_cast<int>(LightLevel::Blue);
+    }
+    CHECK(highLevel);
+
+    std::vector<SignalChange> direct;
+    CHECK(Encoder(config).encodeTo(data.data(), data.size(), [&](const SignalChange &sc) { direct.push_back(sc); }));
+    CHECK(direct.size() == expected.size() && check::sameSymbols(direct.data(), expected.data(), expected.size()));
+
+    StreamEncoder stream(config);
+    stream.start(data.data(), data.size());
+    std::vector<SignalChange> streamed;
+    SignalChange out[32];
+    while (std::size_t n = stream.next(out, 32))
+        streamed.insert(streamed.end(), out, out + n);
+    CHECK(streamed.size() == expected.size() && check::sameSymbols(streamed.data(), expected.data(), expected.size()));
+
+    config.run_length = true;
+    CHECK(check::encoded(Encoder(config), data).size() == expected.size());
+}
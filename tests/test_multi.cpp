@@ -0,0 +1,130 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    struct ChannelPacket
+    {
+        std::size_t channel;
+        uint8_t index;
+        uint16_t word;
+    };
+
+    void collectChannel(std::size_t channel, const UnpackedPackage &package, void *context)
+    {
+        static_cast<std::vector<ChannelPacket> *>(context)->push_back({channel, package.index, package.word});
+    }
+
+    void collect(const UnpackedPackage &package, void *context)
+    {
+        static_cast<std::vector<UnpackedPackage> *>(context)->push_back(package);
+    }
+
+    // Каналы с разными сообщениями и разной длиной потока; на каждом шаге часть
+    // каналов молчит (duration = 0), изредка проскакивает короткий глитч
+    template <std::size_t Channels>
+    void checkAgainstDecoders()
+    {
+        std::vector<std::vector<SignalChange>> streams(Channels);
+        std::size_t steps = 0;
+        for (std::size_t c = 0; c < Channels; ++c)
+        {
+            streams[c] = check::encoded(Encoder(), check::pattern(20 + 14 * c, static_cast<uint8_t>(c)));
+            for (std::size_t i = 5 + c; i < streams[c].size(); i += 37)
+                streams[c].insert(streams[c].begin() + static_cast<long>(i), {LightLevel::Blue, 10});
+            steps += streams[c].size();
+        }
+
+        std::vector<ChannelPacket> multiPackets;
+        MultiDecoder<Channels> multi(collectChannel, &multiPackets);
+        std::vector<std::size_t> position(Channels, 0);
+        std::vector<SignalChange> step(Channels);
+        for (std::size_t tick = 0; tick < steps; ++tick)
+        {
+            for (std::size_t c = 0; c < Channels; ++c)
+            {
+                const bool idle = (tick + c) % 3 == 0 || position[c] >= streams[c].size();
+                step[c] = idle ? SignalChange{LightLevel::Off, 0} : streams[c][position[c]++];
+            }
+            multi.feed(step.data());
+        }
+
+        for (std::size_t c = 0; c < Channels; ++c)
+        {
+            CHECK_EQ(position[c], streams[c].size());
+            std::vector<UnpackedPackage> expected;
+            Decoder decoder(collect, &expected);
+            decoder.feed(streams[c].data(), streams[c].size());
+
+            std::vector<ChannelPacket> got;
+            for (const ChannelPacket &packet : multiPackets)
+            {
+                if (packet.channel == c)
+                    got.push_back(packet);
+            }
+            CHECK_EQ(got.size(), expected.size());
+            for (std::size_t i = 0; i < got.size() && i < expected.size(); ++i)
+                CHECK(got[i].index == expected[i].index && got[i].word == expected[i].word);
+            for (std::size_t i = 0; i < kMaxWords; ++i)
+            {
+                CHECK_EQ(multi.isReceived(c, i), decoder.isReceived(i));
+                CHECK_EQ(multi.receivedWords(c)[i], decoder.receivedWords()[i]);
+            }
+        }
+    }
+}
+
+// Многоканальный декодер выдаёт по каждому каналу те же пакеты, что отдельный Decoder:
+// 3 канала - только скалярный путь, 13 - ядро на 8 каналов и скалярный остаток
+TEST(multi_decoder_matches_decoders)
+{
+    checkAgainstDecoders<3>();
+    checkAgainstDecoders<13>();
+    checkAgainstDecoders<16>();
+}
+
+// Уровни вне классического алфавита канал пропускает, не сдвигая окно, - так же,
+// как Decoder: нечётные каналы получают их между символами, последний - только их
+TEST(multi_decoder_skips_foreign_levels)
+{
+    constexpr std::size_t kChannels = 8;
+    const SignalChange foreign{makeLevel(LightLevel::Red, 2), 125};
+    const auto symbols = check::encoded(Encoder(), check::pattern(40, 50));
+    std::vector<std::vector<SignalChange>> streams(kChannels);
+    std::size_t steps = 0;
+    for (std::size_t c = 0; c < kChannels; ++c)
+    {
+        if (c + 1 < kChannels)
+        {
+            for (std::size_t i = 0; i < symbols.size(); ++i)
+            {
+                streams[c].push_back(symbols[i]);
+                if (c % 2 == 1 && i % 3 == 0)
+                    streams[c].push_back(foreign);
+            }
+        }
+        steps = streams[c].size() > steps ? streams[c].size() : steps;
+    }
+    for (std::vector<SignalChange> &stream : streams)
+        stream.resize(steps, foreign);
+
+    std::vector<ChannelPacket> packets;
+    MultiDecoder<kChannels> multi(collectChannel, &packets);
+    SignalChange step[kChannels];
+    for (std::size_t i = 0; i < steps; ++i)
+    {
+        for (std::size_t c = 0; c < kChannels; ++c)
+            step[c] = streams[c][i];
+        multi.feed(step);
+    }
+    for (std::size_t c = 0; c < kChannels; ++c)
+    {
+        Decoder decoder(nullptr, nullptr);
+        decoder.feed(streams[c].data(), streams[c].size());
+        for (std::size_t i = 0; i < kMaxWords; ++i)
+            CHECK_EQ(multi.isReceived(c, i), decoder.isReceived(i));
+        for (std::size_t i = 0; i < 20; ++i)
+            CHECK_EQ(multi.isReceived(c, i), c + 1 < kChannels);
+    }
+}
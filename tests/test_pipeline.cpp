@@ -0,0 +1,128 @@
+#include "check.h"
+
+#include "datapacklib_host.h"
+
+#if DATAPACK_HAS_COROUTINES
+
+using namespace datapack;
+
+namespace
+{
+    ProtocolConfig syncConfig()
+    {
+        ProtocolConfig config;
+        config.frame_sync = true;
+        config.length_packet = true;
+        return config;
+    }
+
+    // Сообщения подряд. gap = 0 - цепочка уровней продолжается (как у Transmitter),
+    // иначе между сообщениями gap переходов и возврат в Off
+    std::vector<SignalChange> backToBack(const ProtocolConfig &config, const std::vector<std::vector<uint8_t>> &messages,
+                                         std::size_t gap)
+    {
+        const Encoder encoder(config);
+        std::vector<SignalChange> symbols;
+        LightLevel prev = LightLevel::Off;
+        for (const auto &message : messages)
+        {
+            if (gap != 0 && !symbols.empty())
+            {
+                for (std::size_t k = 0; k < gap; ++k)
+                {
+                    prev = prev == LightLevel::White ? LightLevel::Red : LightLevel::White;
+                    symbols.push_back({prev, config.duration});
+                }
+                symbols.push_back({LightLevel::Off, config.duration});
+                prev = LightLevel::Off;
+            }
+            Encoder::Words words;
+            CHECK(encoder.messageWords(message.data(), message.size(), words));
+            std::vector<uint8_t> indices(words.size());
+            for (std::size_t i = 0; i < indices.size(); ++i)
+                indices[i] = static_cast<uint8_t>(i);
+            Encoder::Signals out;
+            encoder.encodeSelected(words.data(), words.size(), indices.data(), indices.size(), out, prev);
+            symbols.insert(symbols.end(), out.data(), out.data() + out.size());
+            SignalChange meta[kSymbolsPerPacket];
+            prev = encodeMetaPacket(out.data()[out.size() - 1].value, kMetaLength, static_cast<uint16_t>(message.size()),
+                                    config, meta);
+            symbols.insert(symbols.end(), meta, meta + symbolsPerPacket(config));
+        }
+        return symbols;
+    }
+
+    std::vector<std::vector<uint8_t>> collectMessages(const ProtocolConfig &config, const std::vector<SignalChange> &symbols)
+    {
+        Decoder decoder(nullptr, nullptr, config);
+        std::vector<std::vector<uint8_t>> got;
+        forEach(decodeMessages(decoder, signalSource(symbols.data(), symbols.size())),
+                [&](const ByteView &view) { got.emplace_back(view.data, view.data + view.size); });
+        return got;
+    }
+}
+
+// frame_sync и сообщения подряд: каждое сообщение выдаётся, вплотную и через паузы
+// разной длины (сдвиг фазы на любое число переходов), одинаковые и разной длины
+TEST(pipeline_decode_messages_back_to_back)
+{
+    const ProtocolConfig config = syncConfig();
+    const std::vector<std::vector<uint8_t>> messages = {check::pattern(20, 1), check::pattern(34, 2),
+                                                        check::pattern(34, 3), check::pattern(34, 3),
+                                                        check::pattern(8, 4)};
+    for (std::size_t gap : {0u, 1u, 2u, 5u, 9u})
+    {
+        const auto got = collectMessages(config, backToBack(config, messages, gap));
+        CHECK_EQ(got.size(), messages.size());
+        for (std::size_t m = 0; m < got.size() && m < messages.size(); ++m)
+            CHECK(got[m] == messages[m]);
+    }
+
+    // без frame_sync - то же
+    ProtocolConfig plain;
+    plain.length_packet = true;
+    const auto got = collectMessages(plain, backToBack(plain, messages, 0));
+    CHECK_EQ(got.size(), messages.size());
+}
+
+// После стадии коллбэк и запасной буфер декодера освобождены
+TEST(pipeline_decode_messages_releases_decoder)
+{
+    const ProtocolConfig config = syncConfig();
+    const auto symbols = backToBack(config, {check::pattern(12, 5)}, 0);
+    Decoder decoder(nullptr, nullptr, config);
+    std::size_t count = 0;
+    forEach(decodeMessages(decoder, signalSource(symbols.data(), symbols.size())), [&](const ByteView &) { ++count; });
+    CHECK_EQ(count, 1);
+    decoder.reset();
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(decoder.complete());
+}
+
+// decodePackets выдаёт те же пакеты, что feed; filterGlitches - тот же фильтр, что у декодера
+TEST(pipeline_packets_match_feed)
+{
+    const ProtocolConfig config = syncConfig();
+    std::vector<SignalChange> symbols = check::encoded(Encoder(config), check::pattern(50, 6));
+    symbols.insert(symbols.begin() + 30, {LightLevel::Green, 10});
+    symbols.insert(symbols.begin() + 70, symbols[69]);
+
+    std::vector<UnpackedPackage> expected(symbols.size());
+    Decoder reference(nullptr, nullptr, config);
+    expected.resize(reference.feed(symbols.data(), symbols.size(), expected.data(), expected.size()));
+
+    std::vector<UnpackedPackage> got;
+    Decoder decoder(nullptr, nullptr, config);
+    forEach(decodePackets(decoder, filterGlitches(signalSource(symbols.data(), symbols.size()), config.min_duration)),
+            [&](const UnpackedPackage &package) { got.push_back(package); });
+    CHECK_EQ(got.size(), expected.size());
+    for (std::size_t i = 0; i < got.size() && i < expected.size(); ++i)
+        CHECK(got[i].index == expected[i].index && got[i].word == expected[i].word);
+
+    std::size_t filtered = 0;
+    forEach(filterGlitches(signalSource(symbols.data(), symbols.size()), config.min_duration),
+            [&](const SignalChange &) { ++filtered; });
+    CHECK_EQ(filtered, symbols.size() - 2);
+}
+
+#endif
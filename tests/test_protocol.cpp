@@ -0,0 +1,82 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    constexpr ProtocolConfig smallConfig()
+    {
+        ProtocolConfig config;
+        config.duration = 200;
+        config.min_duration = 100;
+        config.frame_sync = true;
+        config.length_packet = true;
+        return config;
+    }
+
+    // Маленький буфер, свой полином, настройки зашиты в код
+    struct SmallProtocol : DefaultProtocol
+    {
+        static constexpr std::size_t max_words = 32;
+        static constexpr uint8_t crc_polynomial = 0x31;
+        static constexpr bool fixed_config = true;
+        static constexpr ProtocolConfig config = smallConfig();
+    };
+
+    // Тот же полином и тайминги, но полный буфер - источник пакетов с индексами за 32
+    struct WideProtocol : SmallProtocol
+    {
+        static constexpr std::size_t max_words = 256;
+    };
+
+    template <typename Encoder>
+    std::vector<SignalChange> symbolsOf(const Encoder &encoder, const std::vector<uint8_t> &data)
+    {
+        std::vector<SignalChange> symbols;
+        CHECK(encoder.encodeTo(data.data(), data.size(), [&](const SignalChange &sc) { symbols.push_back(sc); }));
+        return symbols;
+    }
+}
+
+// Свой протокол: обмен идёт, ёмкость ограничена max_words, чужой полином не принимается
+TEST(compile_time_protocol_round_trip)
+{
+    const std::vector<uint8_t> data = check::pattern(50, 31);
+    const BasicEncoder<SmallProtocol> encoder;
+    const auto symbols = check::encoded(encoder, data);
+    CHECK(!symbols.empty());
+    for (const SignalChange &sc : symbols)
+        CHECK_EQ(sc.duration, 200);
+
+    BasicDecoder<SmallProtocol> decoder;
+    decoder.setConfig(ProtocolConfig{}); // fixed_config: не действует
+    CHECK(decoder.config().frame_sync);
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(decoder.complete());
+    CHECK(check::receivedEquals(decoder, data));
+
+    // CRC с полиномом по умолчанию на этом потоке не сходится
+    const ProtocolConfig plain = smallConfig();
+    std::vector<UnpackedPackage> packets(symbols.size());
+    Decoder other(nullptr, nullptr, plain);
+    const std::size_t found = other.feed(symbols.data(), symbols.size(), packets.data(), packets.size());
+    CHECK(found < 2);
+    CHECK(!other.complete());
+
+    BasicEncoder<SmallProtocol>::Signals out;
+    CHECK(!encoder.encode(check::pattern(65).data(), 65, out));
+    CHECK(encoder.encode(check::pattern(64).data(), 64, out));
+}
+
+// Пакеты с индексом за пределами max_words отбрасываются, буфер не переполняется
+TEST(compile_time_protocol_ignores_out_of_range)
+{
+    const std::vector<uint8_t> data = check::pattern(100, 32);
+    const auto symbols = symbolsOf(BasicEncoder<WideProtocol>(), data);
+    BasicDecoder<SmallProtocol> decoder;
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK_EQ(decoder.receivedCount(), 32);
+    CHECK(!decoder.complete());
+    for (std::size_t i = 0; i < 32; ++i)
+        CHECK_EQ(decoder.receivedWords()[i], data[2 * i] | data[2 * i + 1] << 8);
+}
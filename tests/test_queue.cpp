@@ -0,0 +1,79 @@
+#include "check.h"
+
+#include <thread>
+
+using namespace datapack;
+
+namespace
+{
+    void collect(const UnpackedPackage &package, void *context)
+    {
+        static_cast<std::vector<UnpackedPackage> *>(context)->push_back(package);
+    }
+}
+
+// Переполнение отбрасывает и считает элементы; drain забирает всё в порядке записи
+TEST(spsc_queue_overflow_and_drain)
+{
+    SpscQueue<int, 4> queue;
+    CHECK(queue.empty());
+    for (int i = 0; i < 6; ++i)
+        CHECK_EQ(queue.push(i), i < 4);
+    CHECK_EQ(queue.size(), 4);
+    CHECK_EQ(queue.dropped(), 2);
+
+    int value = -1;
+    CHECK(queue.pop(value));
+    CHECK_EQ(value, 0);
+    CHECK(queue.push(4));
+    std::vector<int> drained;
+    CHECK_EQ(queue.drain([&](int v) { drained.push_back(v); }), 4);
+    CHECK(drained == std::vector<int>({1, 2, 3, 4}));
+    CHECK(!queue.pop(value));
+}
+
+// Писатель и читатель в разных потоках: ничего не теряется и не переставляется
+TEST(spsc_queue_two_threads)
+{
+    static SpscQueue<uint32_t, 64> queue;
+    constexpr uint32_t kCount = 200000;
+    std::thread producer([] {
+        for (uint32_t i = 0; i < kCount;)
+            i += queue.push(i) ? 1 : 0;
+    });
+    uint32_t expected = 0;
+    bool ordered = true;
+    while (expected < kCount)
+    {
+        queue.drain([&](uint32_t v) { ordered &= v == expected++; });
+        uint32_t v;
+        if (queue.pop(v))
+            ordered &= v == expected++;
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(queue.empty());
+}
+
+// Пакеты из очереди декодера - те же, что получает коллбэк
+TEST(decoder_queue_matches_callback)
+{
+    ProtocolConfig config;
+    config.frame_sync = true;
+    const auto symbols = check::encoded(Encoder(config), check::pattern(60, 4));
+
+    std::vector<UnpackedPackage> direct;
+    Decoder reference(collect, &direct, config);
+    reference.feed(symbols.data(), symbols.size());
+
+    PacketQueue queue;
+    std::vector<UnpackedPackage> queued;
+    Decoder decoder(nullptr, nullptr, config);
+    decoder.setQueue(&queue);
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK_EQ(drainPackets(queue, collect, &queued), direct.size());
+    CHECK_EQ(queued.size(), direct.size());
+    for (std::size_t i = 0; i < queued.size() && i < direct.size(); ++i)
+        CHECK(queued[i].index == direct[i].index && queued[i].word == direct[i].word);
+    CHECK_EQ(queue.dropped(), 0);
+}
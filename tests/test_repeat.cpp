@@ -0,0 +1,133 @@
+#include "check.h"
+
+#include "datapacklib_host.h"
+
+using namespace datapack;
+
+namespace
+{
+    void collect(const UnpackedPackage &package, void *context)
+    {
+        static_cast<std::vector<UnpackedPackage> *>(context)->push_back(package);
+    }
+
+    ProtocolConfig syncConfig()
+    {
+        ProtocolConfig config;
+        config.frame_sync = true;
+        return config;
+    }
+}
+
+// Первая передача без части пакетов, повтор - только недостающие по карте приёма
+TEST(repeat_missing_completes_message)
+{
+    const ProtocolConfig config = syncConfig();
+    const Encoder encoder(config);
+    const std::vector<uint8_t> data = check::pattern(60, 18);
+    Encoder::Words words;
+    CHECK(encoder.messageWords(data.data(), data.size(), words));
+
+    std::vector<uint8_t> kept;
+    for (std::size_t i = 0; i < words.size(); ++i)
+    {
+        if (i % 7 != 3)
+            kept.push_back(static_cast<uint8_t>(i));
+    }
+    kept.push_back(200); // вне сообщения - пропускается
+    Encoder::Signals first;
+    CHECK_EQ(encoder.encodeSelected(words.data(), words.size(), kept.data(), kept.size(), first), kept.size() - 1);
+
+    Decoder decoder(nullptr, nullptr, config);
+    decoder.feed(first.data(), first.size());
+    CHECK(!check::receivedEquals(decoder, data));
+
+    Encoder::Signals repeat;
+    const std::size_t missing = encoder.encodeMissing(words.data(), words.size(), decoder.receivedBitmap(), repeat,
+                                                      first.data()[first.size() - 1].value);
+    CHECK_EQ(missing, words.size() - (kept.size() - 1));
+    CHECK_EQ(repeat.size(), missing * kSymbolsPerPacket);
+    decoder.feed(repeat.data(), repeat.size());
+    CHECK(check::receivedEquals(decoder, data));
+
+    // всё принято - повторять нечего
+    CHECK_EQ(encoder.encodeMissing(words.data(), words.size(), decoder.receivedBitmap(), repeat), 0);
+    CHECK_EQ(repeat.size(), 0);
+}
+
+// Карусель: круг по порядку со служебным пакетом в конце; приоритетные пакеты
+// вставляются по priorityShare на один фоновый
+TEST(repeat_carousel_order)
+{
+    ProtocolConfig config = syncConfig();
+    config.length_packet = true;
+    const std::vector<uint8_t> data = check::pattern(16, 19);
+    Encoder::Words words;
+    CHECK(Encoder(config).messageWords(data.data(), data.size(), words));
+
+    SignalChange symbols[kSymbolsPerPacket];
+    // пустое сообщение без length_packet - символов нет; с ним идёт один служебный пакет
+    Carousel empty(syncConfig());
+    CHECK_EQ(empty.next(symbols, 4), 0);
+
+    Carousel carousel(config);
+    carousel.start(words.data(), words.size(), static_cast<uint16_t>(data.size()));
+    carousel.setPriorityShare(2);
+    std::vector<UnpackedPackage> packets;
+    Decoder decoder(collect, &packets, config);
+    // первый круг целиком, второй - с тремя пакетами вне очереди
+    for (std::size_t k = 0; k < words.size() + 1; ++k)
+        decoder.feed(symbols, carousel.next(symbols, kSymbolsPerPacket));
+    CHECK(check::receivedEquals(decoder, data));
+    carousel.prioritize(6);
+    carousel.prioritize(2);
+    carousel.prioritize(6);
+    carousel.prioritize(100); // вне сообщения
+    carousel.prioritizeLength();
+    CHECK_EQ(carousel.pendingCount(), 3);
+    for (std::size_t k = 0; k < 6; ++k)
+    {
+        // выдача кусками, не кратными пакету
+        decoder.feed(symbols, carousel.next(symbols, 5));
+        decoder.feed(symbols, carousel.next(symbols, 11));
+    }
+    CHECK_EQ(carousel.pendingCount(), 0);
+
+    // служебные пакеты в коллбэк не попадают: круг 0..7, затем length, 2, 0, 6, 1, 2
+    const uint8_t expected[] = {0, 1, 2, 3, 4, 5, 6, 7, 2, 0, 6, 1, 2};
+    CHECK_EQ(packets.size(), sizeof(expected));
+    for (std::size_t i = 0; i < packets.size() && i < sizeof(expected); ++i)
+        CHECK_EQ(packets[i].index, expected[i]);
+}
+
+// По каналу с потерями карусель с досылкой по карте приёма доводит сообщение
+// заметно раньше, чем за два полных круга
+TEST(repeat_carousel_over_lossy_channel)
+{
+    const ProtocolConfig config = syncConfig();
+    const std::vector<uint8_t> data = check::pattern(200, 20);
+    Encoder::Words words;
+    CHECK(Encoder(config).messageWords(data.data(), data.size(), words));
+    ChannelParams params;
+    params.drop = 0.01;
+    params.seed = 3;
+
+    Carousel carousel(config);
+    carousel.start(words.data(), words.size());
+    carousel.setPriorityShare(8);
+    ChannelModel channel(params);
+    Decoder decoder(nullptr, nullptr, config);
+    auto sink = [&](const SignalChange &sc) { decoder.feed(sc); };
+    SignalChange symbols[kSymbolsPerPacket];
+    std::size_t sent = 0;
+    while (!check::receivedEquals(decoder, data) && sent < 10 * words.size())
+    {
+        channel.transmit(symbols, carousel.next(symbols, kSymbolsPerPacket), sink);
+        ++sent;
+        // обратный канал сообщает карту приёма раз в 20 пакетов, начиная с конца круга
+        if (sent >= words.size() && sent % 20 == 0)
+            carousel.prioritizeMissing(decoder.receivedBitmap());
+    }
+    CHECK(check::receivedEquals(decoder, data));
+    CHECK(sent < words.size() * 3 / 2);
+}
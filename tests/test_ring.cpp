@@ -0,0 +1,36 @@
+#include "check.h"
+
+using namespace datapack;
+
+// RingBuffer хранит то же, что StaticVector::shift_and_push, и в том же порядке
+TEST(ring_buffer_matches_shift_and_push)
+{
+    StaticVector<int, 5> shifted;
+    RingBuffer<int, 5> ring;
+    for (int value = 0; value < 23; ++value)
+    {
+        shifted.shift_and_push(value);
+        CHECK(ring.push_back(value));
+        CHECK_EQ(ring.dropped(), value < 5 ? 0u : static_cast<std::size_t>(value - 4));
+        CHECK_EQ(ring.size(), shifted.size());
+        for (std::size_t i = 0; i < ring.size(); ++i)
+            CHECK_EQ(ring[i], shifted[i]);
+        CHECK_EQ(ring.back(), value);
+
+        int copy[5] = {};
+        CHECK_EQ(ring.copyTo(copy), ring.size());
+        const RingBuffer<int, 5>::Spans parts = ring.spans();
+        CHECK_EQ(parts.first_size + parts.second_size, ring.size());
+        for (std::size_t i = 0; i < ring.size(); ++i)
+        {
+            CHECK_EQ(copy[i], shifted[i]);
+            CHECK_EQ(i < parts.first_size ? parts.first[i] : parts.second[i - parts.first_size], shifted[i]);
+        }
+    }
+    CHECK(ring.full());
+    ring.clear();
+    CHECK_EQ(ring.size(), 0);
+    CHECK_EQ(ring.dropped(), 0);
+    CHECK(ring.push_back(7));
+    CHECK_EQ(ring[0], 7);
+}
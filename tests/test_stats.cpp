@@ -0,0 +1,92 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    using InstrumentedDecoder = BasicDecoder<InstrumentedProtocol>;
+
+    struct SmallInstrumentedProtocol : InstrumentedProtocol
+    {
+        static constexpr std::size_t max_words = 32;
+    };
+
+    void feedOneByOne(InstrumentedDecoder &decoder, const std::vector<SignalChange> &symbols)
+    {
+        for (const SignalChange &sc : symbols)
+            decoder.feed(sc);
+    }
+}
+
+// Счётчики сходятся с тем, что подано: глитч, повтор уровня, пакеты и их повторы.
+// Поштучный и пакетный feed считают одинаково.
+TEST(stats_count_feed_events)
+{
+    ProtocolConfig config;
+    config.frame_sync = true;
+    const std::vector<uint8_t> data = check::pattern(40, 9);
+    std::vector<SignalChange> symbols = check::encoded(Encoder(config), data);
+    const std::size_t words = data.size() / 2;
+    symbols.insert(symbols.begin() + 20, {LightLevel::Blue, 10});
+    symbols.insert(symbols.begin() + 40, symbols[39]);
+
+    InstrumentedDecoder bulk(nullptr, nullptr, config);
+    InstrumentedDecoder single(nullptr, nullptr, config);
+    bulk.feed(symbols.data(), symbols.size());
+    feedOneByOne(single, symbols);
+    CHECK(check::receivedEquals(bulk, data));
+
+    for (const DecoderStats &stats : {bulk.statistics(), single.statistics()})
+    {
+        CHECK_EQ(stats.symbols, symbols.size());
+        CHECK_EQ(stats.glitches, 1);
+        CHECK_EQ(stats.repeats, 1);
+        CHECK_EQ(stats.packets, words);
+        CHECK_EQ(stats.duplicates, 0);
+        CHECK_EQ(stats.rewrites, 0);
+        CHECK_EQ(stats.sync_losses, 0);
+        CHECK(stats.crc_pass >= words);
+        CHECK(stats.crc_fail > 0);
+    }
+
+    // то же сообщение ещё раз после паузы в Off - все пакеты повторяют принятые слова
+    bulk.feed({LightLevel::Off, config.duration});
+    bulk.feed(symbols.data(), symbols.size());
+    CHECK_EQ(bulk.statistics().packets, 2 * words);
+    CHECK_EQ(bulk.statistics().duplicates, words);
+
+    bulk.resetStatistics();
+    CHECK_EQ(bulk.statistics().symbols, 0);
+    CHECK_EQ(bulk.statistics().packets, 0);
+}
+
+// Служебный пакет длины и пакет вне буфера считаются отдельно
+TEST(stats_count_meta_and_out_of_range)
+{
+    ProtocolConfig config;
+    config.length_packet = true;
+    const std::vector<uint8_t> data = check::pattern(30, 10);
+    const auto symbols = check::encoded(Encoder(config), data);
+    InstrumentedDecoder decoder(nullptr, nullptr, config);
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(decoder.statistics().meta_packets >= 1);
+
+    // индекс 40 за пределами max_words = 32: пакет проходит CRC, но не записывается
+    SignalChange packet[kSymbolsPerPacket];
+    encodePacket(LightLevel::Off, 40, 0x1234, config.duration, packet);
+    BasicDecoder<SmallInstrumentedProtocol> plain;
+    plain.feed(packet, kSymbolsPerPacket);
+    CHECK_EQ(plain.statistics().out_of_range, 1);
+    CHECK_EQ(plain.statistics().packets, 0);
+}
+
+// Без statistics счётчиков нет: декодер не растёт, снимок - нули
+TEST(stats_compiled_out_by_default)
+{
+    CHECK(sizeof(Decoder) < sizeof(InstrumentedDecoder));
+    const auto symbols = check::encoded(Encoder(), check::pattern(20, 11));
+    Decoder decoder;
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK_EQ(decoder.statistics().symbols, 0);
+    CHECK_EQ(decoder.statistics().packets, 0);
+}
@@ -0,0 +1,122 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    std::vector<SignalChange> drain(StreamEncoder &encoder, std::size_t chunk = 13)
+    {
+        std::vector<SignalChange> symbols;
+        SignalChange out[64];
+        while (std::size_t n = encoder.next(out, chunk))
+            symbols.insert(symbols.end(), out, out + n);
+        return symbols;
+    }
+
+    void collect(const UnpackedPackage &package, void *context)
+    {
+        static_cast<std::vector<UnpackedPackage> *>(context)->push_back(package);
+    }
+}
+
+// Кодер, которому не дали сообщения, ничего не передаёт - и с length_packet тоже
+TEST(stream_encoder_is_idle_until_started)
+{
+    ProtocolConfig config;
+    config.length_packet = true;
+    StreamEncoder encoder(config);
+    CHECK(encoder.done());
+    CHECK(drain(encoder).empty());
+
+    const std::vector<uint8_t> data = check::pattern(10);
+    encoder.start(data.data(), data.size());
+    CHECK(!encoder.done());
+    CHECK_EQ(drain(encoder).size(), (5 + 1) * kSymbolsPerPacket);
+    CHECK(encoder.done());
+
+    // явный start пустого сообщения - это сообщение нулевой длины
+    encoder.start(data.data(), 0);
+    CHECK_EQ(drain(encoder).size(), kSymbolsPerPacket);
+}
+
+// Сообщение длиннее 256 слов: первые 256 пакетов как у Encoder, дальше - сегменты,
+// которые декодер segmented принимает по порядку
+TEST(stream_encoder_long_message_segments)
+{
+    ProtocolConfig config;
+    config.segmented = true;
+    const std::vector<uint8_t> data = check::pattern(1001, 3);
+    StreamEncoder encoder(config);
+    encoder.start(data.data(), data.size());
+    const std::vector<SignalChange> symbols = drain(encoder);
+    const std::size_t packets = (data.size() + 1) / 2;
+    CHECK_EQ(symbols.size(), packets * kSymbolsPerPacket);
+    CHECK_EQ(encoder.packets(), packets);
+
+    const auto head = check::encoded(Encoder(config), std::vector<uint8_t>(data.begin(), data.begin() + 512));
+    CHECK(check::sameSymbols(head.data(), symbols.data(), head.size()));
+
+    std::vector<UnpackedPackage> received;
+    Decoder decoder(collect, &received, config);
+    decoder.feed(symbols.data(), symbols.size());
+    std::vector<bool> seen(packets, false);
+    for (const UnpackedPackage &package : received)
+    {
+        const std::size_t n = package.segment * 256u + package.index;
+        if (n >= packets)
+            continue;
+        const uint16_t word = static_cast<uint16_t>(data[2 * n] | (2 * n + 1 < data.size() ? data[2 * n + 1] << 8 : 0));
+        if (package.word == word)
+            seen[n] = true;
+    }
+    std::size_t delivered = 0;
+    for (bool s : seen)
+        delivered += s;
+    CHECK_EQ(delivered, packets);
+    CHECK_EQ(decoder.segment(), 1);
+}
+
+// Сообщению длиннее kMaxWords слов пакет длины не нужен: декодер его не собрал бы
+TEST(stream_encoder_skips_length_of_long_message)
+{
+    ProtocolConfig config;
+    config.length_packet = true;
+    StreamEncoder encoder(config);
+    const std::vector<uint8_t> fits = check::pattern(kMaxWords * 2, 4);
+    encoder.start(fits.data(), fits.size());
+    CHECK_EQ(drain(encoder).size(), (kMaxWords + 1) * kSymbolsPerPacket);
+
+    const std::vector<uint8_t> longer = check::pattern(kMaxWords * 2 + 1, 4);
+    encoder.start(longer.data(), longer.size());
+    CHECK_EQ(drain(encoder).size(), (kMaxWords + 1) * kSymbolsPerPacket);
+    CHECK(encoder.done());
+}
+
+// Данные из ByteSource кодируются так же, как из буфера (без пакета длины)
+TEST(stream_encoder_byte_source)
+{
+    struct Source
+    {
+        const std::vector<uint8_t> *data;
+        std::size_t pos;
+    };
+    const std::vector<uint8_t> data = check::pattern(77, 5);
+    Source source{&data, 0};
+    StreamEncoder fromSource;
+    fromSource.start(
+        [](uint8_t *dst, std::size_t max, void *context) {
+            Source &s = *static_cast<Source *>(context);
+            std::size_t n = s.data->size() - s.pos < max ? s.data->size() - s.pos : max;
+            n = n > 5 ? 5 : n; // мелкие порции, чтобы слово пересекало их границу
+            std::memcpy(dst, s.data->data() + s.pos, n);
+            s.pos += n;
+            return n;
+        },
+        &source);
+    StreamEncoder fromBuffer;
+    fromBuffer.start(data.data(), data.size());
+    const auto a = drain(fromSource, 64);
+    const auto b = drain(fromBuffer, 64);
+    CHECK_EQ(a.size(), b.size());
+    CHECK(check::sameSymbols(a.data(), b.data(), a.size()));
+}
@@ -0,0 +1,90 @@
+#include "check.h"
+
+#include "datapacklib_host.h"
+
+using namespace datapack;
+
+namespace
+{
+    // Трасса из многих сообщений через зашумлённый канал; между сообщениями пауза в Off
+    std::vector<SignalChange> noisyTrace(const ProtocolConfig &config, std::size_t messages)
+    {
+        ChannelParams params;
+        params.drop = 0.002;
+        params.glitch = 0.01;
+        params.confusion = 0.002;
+        params.jitter = 0.1;
+        params.seed = 7;
+        ChannelModel model(params);
+        std::vector<SignalChange> trace;
+        auto sink = [&](const SignalChange &sc) { trace.push_back(sc); };
+        const SignalChange gap{LightLevel::Off, config.duration};
+        Encoder encoder(config);
+        for (std::size_t m = 0; m < messages; ++m)
+        {
+            const auto symbols = check::encoded(encoder, check::pattern(40 + m % 90, static_cast<uint8_t>(m)));
+            model.transmit(&gap, 1, sink);
+            model.transmit(symbols.data(), symbols.size(), sink);
+        }
+        model.flush(sink);
+        return trace;
+    }
+
+    bool samePackets(const std::vector<TracePacket> &a, const std::vector<TracePacket> &b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].position != b[i].position || a[i].package.index != b[i].package.index ||
+                a[i].package.word != b[i].package.word)
+                return false;
+        }
+        return true;
+    }
+
+    void checkParallelMatchesSequential(const ProtocolConfig &config)
+    {
+        const auto trace = noisyTrace(config, 400);
+        std::vector<TracePacket> sequential;
+        decodeTraceRange(trace.data(), 0, trace.size(), 0, config, sequential);
+        CHECK(sequential.size() > 1000);
+        for (unsigned threads : {1u, 2u, 3u, 8u})
+            CHECK(samePackets(decodeTrace(trace.data(), trace.size(), config, threads), sequential));
+    }
+}
+
+// Куски с разгоном дают те же пакеты и позиции, что один проход, и без повторов на стыках
+TEST(trace_parallel_matches_sequential)
+{
+    checkParallelMatchesSequential(ProtocolConfig());
+}
+
+TEST(trace_parallel_matches_sequential_frame_sync)
+{
+    ProtocolConfig config;
+    config.frame_sync = true;
+    checkParallelMatchesSequential(config);
+}
+
+// segmented зависит от всей предыстории - трасса декодируется одним куском
+TEST(trace_segmented_stays_sequential)
+{
+    ProtocolConfig config;
+    config.segmented = true;
+    const auto trace = noisyTrace(config, 100);
+    std::vector<TracePacket> sequential;
+    decodeTraceRange(trace.data(), 0, trace.size(), 0, config, sequential);
+    CHECK(!sequential.empty());
+    CHECK(samePackets(decodeTrace(trace.data(), trace.size(), config, 4), sequential));
+}
+
+// Короткая трасса не делится: результат тот же
+TEST(trace_short_is_one_chunk)
+{
+    const auto trace = noisyTrace(ProtocolConfig(), 2);
+    std::vector<TracePacket> sequential;
+    decodeTraceRange(trace.data(), 0, trace.size(), 0, ProtocolConfig(), sequential);
+    CHECK(samePackets(decodeTrace(trace.data(), trace.size(), ProtocolConfig(), 8), sequential));
+    CHECK(decodeTrace(trace.data(), 0, ProtocolConfig(), 8).empty());
+}
@@ -0,0 +1,100 @@
+#include "check.h"
+
+#include "datapacklib_host.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace datapack;
+
+namespace
+{
+    struct TracedProtocol : DefaultProtocol
+    {
+        static constexpr bool tracing = true;
+    };
+
+    uint32_t ticks = 0;
+
+    // Часы тикают при каждом чтении: по отметкам видно, сколько раз их читали
+    uint32_t countingClock()
+    {
+        return ++ticks;
+    }
+}
+
+// Пакетный feed читает часы на каждый переход: отметки переходов одной пачки
+// растут, пакет отмечен после своего последнего перехода (первый пакет frame_sync -
+// вместе со вторым, подтвердившим захват)
+TEST(tracing_stamps_each_transition)
+{
+    ProtocolConfig config;
+    config.frame_sync = true;
+    const std::vector<uint8_t> data = check::pattern(8, 12);
+    std::vector<SignalChange> symbols = check::encoded(Encoder(config), data);
+    symbols.insert(symbols.begin() + 5, {LightLevel::Blue, 10});
+
+    TraceRing ring;
+    BasicDecoder<TracedProtocol> decoder(nullptr, nullptr, config);
+    decoder.setTrace(&ring, countingClock);
+    ticks = 0;
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK(check::receivedEquals(decoder, data));
+    CHECK_EQ(ring.size(), symbols.size() + data.size() / 2);
+
+    std::size_t transitions = 0;
+    std::size_t packets = 0;
+    std::size_t passes = 0;
+    uint32_t last = 0;
+    for (std::size_t i = 0; i < ring.size(); ++i)
+    {
+        const TraceRecord &record = ring[i];
+        CHECK(record.timestamp > last);
+        last = record.timestamp;
+        switch (static_cast<TraceEvent>(record.event))
+        {
+        case TraceEvent::Symbol:
+        case TraceEvent::Filtered:
+            ++transitions;
+            passes += record.crc == static_cast<uint8_t>(TraceCrc::Pass);
+            break;
+        case TraceEvent::Packet:
+            CHECK_EQ(record.window >> 16 & 0xFF, packets);
+            CHECK(i > 0 && ring[i - 1].event != static_cast<uint8_t>(TraceEvent::Filtered));
+            ++packets;
+            break;
+        default:
+            CHECK(false);
+        }
+    }
+    CHECK_EQ(transitions, symbols.size());
+    CHECK_EQ(packets, data.size() / 2);
+    CHECK_EQ(passes, packets);
+    CHECK_EQ(ring[5].event, static_cast<uint8_t>(TraceEvent::Filtered));
+    CHECK_EQ(ticks, ring.size());
+}
+
+// Дамп переносим: parseTrace возвращает те же записи, printTrace печатает по строке на запись
+TEST(tracing_dump_round_trip)
+{
+    const std::vector<uint8_t> data = check::pattern(6, 13);
+    const auto symbols = check::encoded(Encoder(), data);
+    TraceRing ring;
+    BasicDecoder<TracedProtocol> decoder;
+    decoder.setTrace(&ring, countingClock);
+    decoder.feed(symbols.data(), symbols.size());
+
+    std::vector<uint8_t> bytes(kTraceCapacity * kTraceRecordSize);
+    const std::size_t size = dumpTrace(ring, bytes.data());
+    CHECK_EQ(size, ring.size() * kTraceRecordSize);
+    const std::vector<TraceRecord> records = parseTrace(bytes.data(), size + 7);
+    CHECK_EQ(records.size(), ring.size());
+    for (std::size_t i = 0; i < records.size() && i < ring.size(); ++i)
+        CHECK(std::memcmp(&records[i], &ring[i], sizeof(TraceRecord)) == 0);
+
+    std::ostringstream text;
+    printTrace(records, text);
+    const std::string dump = text.str();
+    CHECK_EQ(static_cast<long long>(std::count(dump.begin(), dump.end(), '\n')), records.size());
+    CHECK(dump.find("packet") != std::string::npos);
+}
@@ -0,0 +1,196 @@
+#include "check.h"
+
+#include "datapacklib_host.h"
+
+using namespace datapack;
+
+namespace
+{
+    // Излучатель: уровень из set_level, длительность - из следующего arm
+    struct Line
+    {
+        LightLevel level = LightLevel::Off;
+        std::vector<SignalChange> symbols;
+    };
+
+    void setLevel(LightLevel level, void *context)
+    {
+        static_cast<Line *>(context)->level = level;
+    }
+
+    void arm(long duration, void *context)
+    {
+        Line *line = static_cast<Line *>(context);
+        line->symbols.push_back({line->level, duration});
+    }
+
+    struct Inbox
+    {
+        std::vector<std::vector<uint8_t>> messages;
+    };
+
+    void store(const uint8_t *data, std::size_t len, void *context)
+    {
+        static_cast<Inbox *>(context)->messages.emplace_back(data, data + len);
+    }
+
+    void countPacket(const UnpackedPackage &, void *context)
+    {
+        ++*static_cast<std::size_t *>(context);
+    }
+
+    // Основной цикл и прерывание таймера по очереди: каждое сообщение передаётся в
+    // send, как только освободилось место, pump - между срабатываниями таймера
+    void transmitAll(Transmitter &transmitter, const std::vector<std::vector<uint8_t>> &messages)
+    {
+        std::size_t next = 0;
+        for (;;)
+        {
+            if (next < messages.size() && transmitter.send(messages[next].data(), messages[next].size()))
+                ++next;
+            if (!transmitter.pump() && next == messages.size())
+                break;
+            if (transmitter.running())
+                transmitter.onTimer();
+        }
+    }
+
+    ProtocolConfig syncConfig()
+    {
+        ProtocolConfig config;
+        config.frame_sync = true;
+        config.length_packet = true;
+        return config;
+    }
+}
+
+// Сообщения в очереди идут одним потоком без пауз и сдвигов фазы: декодер с
+// frame_sync принимает каждый пакет и каждое сообщение целиком
+TEST(transmitter_chains_queued_messages)
+{
+    const ProtocolConfig config = syncConfig();
+    std::vector<std::vector<uint8_t>> messages;
+    std::size_t words = 0;
+    for (std::size_t m = 0; m < 6; ++m)
+    {
+        messages.push_back(check::pattern(20 + 14 * m, static_cast<uint8_t>(m + 30)));
+        words += (messages.back().size() + 1) / 2;
+    }
+
+    Line line;
+    Transmitter transmitter(TransmitDriver{setLevel, arm, &line}, config);
+    transmitAll(transmitter, messages);
+    CHECK(transmitter.idle());
+    CHECK(line.level == LightLevel::Off);
+
+    // без пауз: символов ровно столько, сколько в пакетах, плюс одна пауза в конце
+    const std::size_t packets = words + messages.size();
+    const std::size_t tail = line.symbols.size() - packets * kSymbolsPerPacket;
+    CHECK(tail <= 1);
+    for (std::size_t i = 1; i < line.symbols.size(); ++i)
+        CHECK(line.symbols[i].value != line.symbols[i - 1].value);
+
+    Inbox inbox;
+    std::size_t received = 0;
+    uint16_t spare[kMaxWords];
+    Decoder decoder(countPacket, &received, config);
+    decoder.setSpareBuffer(spare);
+    decoder.setMessageCallback(store, &inbox);
+    decoder.feed(line.symbols.data(), line.symbols.size());
+    CHECK_EQ(received, words);
+    CHECK_EQ(inbox.messages.size(), messages.size());
+    for (std::size_t m = 0; m < inbox.messages.size() && m < messages.size(); ++m)
+        CHECK(inbox.messages[m] == messages[m]);
+}
+
+// Передатчик успел остановиться: пауза Off, излучатель гаснет, следующее
+// сообщение начинается с Off и тоже принимается
+TEST(transmitter_restarts_from_off)
+{
+    const ProtocolConfig config = syncConfig();
+    const std::vector<std::vector<uint8_t>> messages = {check::pattern(24, 40), check::pattern(30, 41)};
+    Line line;
+    Transmitter transmitter(TransmitDriver{setLevel, arm, &line}, config);
+    transmitAll(transmitter, {messages[0]});
+    const std::size_t first = line.symbols.size();
+    CHECK(line.symbols.back().value == LightLevel::Off || line.symbols.size() % kSymbolsPerPacket == 0);
+    transmitAll(transmitter, {messages[1]});
+    CHECK(line.symbols.size() > first);
+
+    Inbox inbox;
+    uint16_t spare[kMaxWords];
+    Decoder decoder(nullptr, nullptr, config);
+    decoder.setSpareBuffer(spare);
+    decoder.setMessageCallback(store, &inbox);
+    decoder.feed(line.symbols.data(), line.symbols.size());
+    CHECK_EQ(inbox.messages.size(), 2);
+    for (std::size_t m = 0; m < inbox.messages.size() && m < messages.size(); ++m)
+        CHECK(inbox.messages[m] == messages[m]);
+}
+
+// StreamEncoder с уровнем продолжения даёт те же символы, что сообщения Encoder,
+// закодированные одной цепочкой
+TEST(stream_encoder_continues_chain)
+{
+    const std::vector<uint8_t> a = check::pattern(22, 42);
+    const std::vector<uint8_t> b = check::pattern(16, 43);
+    StreamEncoder stream;
+    std::vector<SignalChange> symbols(2 * kMaxWords * kSymbolsPerPacket);
+    stream.start(a.data(), a.size());
+    std::size_t count = stream.next(symbols.data(), symbols.size());
+    stream.start(b.data(), b.size(), stream.last());
+    count += stream.next(symbols.data() + count, symbols.size() - count);
+
+    const Encoder encoder;
+    const auto first = check::encoded(encoder, a);
+    Encoder::Words words;
+    CHECK(encoder.messageWords(b.data(), b.size(), words));
+    std::vector<uint8_t> indices(words.size());
+    for (std::size_t i = 0; i < indices.size(); ++i)
+        indices[i] = static_cast<uint8_t>(i);
+    Encoder::Signals second;
+    encoder.encodeSelected(words.data(), words.size(), indices.data(), indices.size(), second, first.back().value);
+    CHECK_EQ(count, first.size() + second.size());
+    CHECK(check::sameSymbols(symbols.data(), first.data(), first.size()));
+    CHECK(check::sameSymbols(symbols.data() + first.size(), second.data(), second.size()));
+}
+
+// HostTransmitter: поток с абсолютными сроками передаёт несколько сообщений подряд
+TEST(host_transmitter_loopback)
+{
+    ProtocolConfig config = syncConfig();
+    config.duration = 2; // микросекунды: тест не ждёт дольше нескольких миллисекунд
+    config.min_duration = 1;
+    std::vector<std::vector<uint8_t>> messages;
+    for (std::size_t m = 0; m < 4; ++m)
+        messages.push_back(check::pattern(18 + 6 * m, static_cast<uint8_t>(m + 50)));
+
+    struct Recorder
+    {
+        std::vector<LightLevel> levels;
+    } recorder;
+    HostTransmitter transmitter(
+        [](LightLevel level, void *context) { static_cast<Recorder *>(context)->levels.push_back(level); }, &recorder,
+        config);
+    for (const auto &message : messages)
+        CHECK(transmitter.send(message.data(), message.size()));
+    transmitter.flush();
+    transmitter.stop();
+
+    // длительности на хосте - время сна, поэтому декодеру подаются номинальные
+    std::vector<SignalChange> symbols;
+    for (LightLevel level : recorder.levels)
+    {
+        if (symbols.empty() || symbols.back().value != level)
+            symbols.push_back({level, config.duration});
+    }
+    Inbox inbox;
+    uint16_t spare[kMaxWords];
+    Decoder decoder(nullptr, nullptr, config);
+    decoder.setSpareBuffer(spare);
+    decoder.setMessageCallback(store, &inbox);
+    decoder.feed(symbols.data(), symbols.size());
+    CHECK_EQ(inbox.messages.size(), messages.size());
+    for (std::size_t m = 0; m < inbox.messages.size() && m < messages.size(); ++m)
+        CHECK(inbox.messages[m] == messages[m]);
+}
@@ -0,0 +1,119 @@
+#include "check.h"
+
+using namespace datapack;
+
+namespace
+{
+    bool sameSignals(const Encoder::Signals &a, const Encoder::Signals &b)
+    {
+        return a.size() == b.size() && check::sameSymbols(a.data(), b.data(), a.size());
+    }
+
+    // Правки в байтах [first, first + changed): update даёт то же, что encode с нуля
+    void checkUpdates(const ProtocolConfig &config, std::size_t len)
+    {
+        const Encoder encoder(config);
+        std::vector<uint8_t> data = check::pattern(len, 16);
+        Encoder::Signals patched;
+        CHECK(encoder.encode(data.data(), data.size(), patched));
+        const std::size_t edits[][2] = {{0, 1}, {7, 2}, {len / 2, 5}, {len - 1, 1}, {len - 3, 10}, {3, 0}, {len, 4}};
+        uint8_t fill = 1;
+        for (const auto &edit : edits)
+        {
+            for (std::size_t i = edit[0]; i < edit[0] + edit[1] && i < len; ++i)
+                data[i] = static_cast<uint8_t>(data[i] * 31 + fill++);
+            CHECK(encoder.update(data.data(), data.size(), edit[0], edit[1], patched));
+            Encoder::Signals full;
+            CHECK(encoder.encode(data.data(), data.size(), full));
+            CHECK(sameSignals(patched, full));
+        }
+    }
+}
+
+TEST(update_matches_full_encode)
+{
+    checkUpdates(ProtocolConfig(), 101);
+
+    ProtocolConfig config;
+    config.length_packet = true;
+    checkUpdates(config, 64);
+
+    config = ProtocolConfig();
+    config.run_length = true;
+    checkUpdates(config, 80);
+
+    config = ProtocolConfig();
+    config.modulation = Modulation::Intensity4;
+    checkUpdates(config, 50);
+
+    // с FEC сообщение кодируется заново, результат тот же
+    config = ProtocolConfig();
+    config.fec_group = 4;
+    checkUpdates(config, 60);
+}
+
+// Длина меняется, а число пакетов нет (39 -> 40 байт): служебный пакет несёт новую длину
+TEST(update_rewrites_length_packet)
+{
+    ProtocolConfig config;
+    config.length_packet = true;
+    const Encoder encoder(config);
+    const std::vector<uint8_t> data = check::pattern(40, 17);
+    Encoder::Signals patched;
+    CHECK(encoder.encode(data.data(), 39, patched));
+    CHECK(encoder.update(data.data(), 40, 39, 1, patched));
+    Encoder::Signals full;
+    CHECK(encoder.encode(data.data(), 40, full));
+    CHECK(sameSignals(patched, full));
+
+    // и обратно: отброшенный байт 39 меняет лишь дополнение последнего слова
+    CHECK(encoder.update(data.data(), 39, 39, 1, patched));
+    CHECK(encoder.encode(data.data(), 39, full));
+    CHECK(sameSignals(patched, full));
+}
+
+// updateWords по словам; out другого размера - полное кодирование
+TEST(update_words_matches_encode_words)
+{
+    const Encoder encoder;
+    std::vector<uint16_t> words(120);
+    for (std::size_t i = 0; i < words.size(); ++i)
+        words[i] = static_cast<uint16_t>(i * 2654435761u >> 16);
+    Encoder::Signals patched;
+    CHECK(encoder.encodeWords(words.data(), words.size(), patched));
+    for (std::size_t first : {0u, 17u, 60u, 119u})
+    {
+        for (std::size_t i = first; i < first + 3 && i < words.size(); ++i)
+            words[i] ^= 0x5A5A;
+        CHECK(encoder.updateWords(words.data(), words.size(), first, 3, patched));
+        Encoder::Signals full;
+        CHECK(encoder.encodeWords(words.data(), words.size(), full));
+        CHECK(sameSignals(patched, full));
+    }
+
+    Encoder::Signals stale;
+    CHECK(encoder.encodeWords(words.data(), 10, stale));
+    CHECK(encoder.updateWords(words.data(), words.size(), 5, 1, stale));
+    Encoder::Signals full;
+    CHECK(encoder.encodeWords(words.data(), words.size(), full));
+    CHECK(sameSignals(stale, full));
+}
+
+// Глобальный updateSendData - то же, что setSendData с изменёнными данными
+TEST(update_send_data_matches_set_send_data)
+{
+    std::vector<uint8_t> data = check::pattern(400, 17);
+    setSendData(data.data(), data.size());
+    const uint8_t edit[] = {0xDE, 0xAD, 0xBE};
+    updateSendData(201, edit, sizeof(edit));
+    const std::vector<SignalChange> patched(send_commands.data(), send_commands.data() + send_commands.size());
+
+    std::memcpy(data.data() + 201, edit, sizeof(edit));
+    setSendData(data.data(), data.size());
+    CHECK_EQ(patched.size(), send_commands.size());
+    CHECK(patched.size() == send_commands.size() && check::sameSymbols(patched.data(), send_commands.data(), patched.size()));
+
+    // запись за концом сообщения отбрасывается
+    updateSendData(data.size(), edit, sizeof(edit));
+    CHECK(check::sameSymbols(patched.data(), send_commands.data(), patched.size()));
+}
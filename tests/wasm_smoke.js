@@ -0,0 +1,67 @@
+/*
+ * Smoke test of the WebAssembly build through datapacklib_wasm.js:
+ * setSendData -> getSendTransitions -> feed -> getVerifiedData.
+ *   make wasm-test                                   (needs emcc and node)
+ *   node tests/wasm_smoke.js build/datapacklib_core.js
+ */
+
+"use strict";
+
+const path = require("path");
+const datapackWasm = require("../datapacklib_wasm.js");
+
+const corePath = path.resolve(process.argv[2] || path.join(__dirname, "..", "build", "datapacklib_core.js"));
+
+let failures = 0;
+const check = (condition, message) => {
+	if (!condition) {
+		failures += 1;
+		console.error(`FAILED: ${message}`);
+	}
+};
+
+const sameBytes = (a, b) => a.length === b.length && a.every((byte, i) => byte === b[i]);
+
+const main = async () => {
+	const api = await datapackWasm.load(require(corePath));
+
+	// одно сообщение пачкой: Int32Array пар туда и обратно
+	const message = Uint8Array.from({ length: 41 }, (_, i) => (i * 37 + 11) & 0xff);
+	const packets = [];
+	api.setOnPacketReceived((packet) => packets.push(packet));
+	api.setSendData(message);
+	const transitions = api.getSendTransitions();
+	check(transitions instanceof Int32Array, "getSendTransitions returns an Int32Array");
+	check(transitions.length === 2 * 21 * 16, `transition pairs: ${transitions.length}`);
+	check(api.feed(transitions) >= 21, "bulk feed finds every packet");
+	check(sameBytes(api.getVerifiedData().subarray(0, 41), message), "verified data matches");
+	check(packets.some((p) => p.index === 20 && p.word === message[40]), "callback gets the last packet");
+
+	// по одному переходу, как в datapacklib.js: последний переход пакета возвращает его
+	api.resetDecoder();
+	api.setSendData("Hello, IR!");
+	let last = null;
+	for (const command of api.getSendCommands()) {
+		last = api.feed(command) || last;
+	}
+	check(last && last.valid && last.index === 4, "single-transition feed returns packets");
+	check(new TextDecoder().decode(api.getVerifiedData()) === "Hello, IR!", "text message round trip");
+
+	// переходы массивом объектов и смена длительности символа
+	api.resetDecoder();
+	api.setSignalDuration(250);
+	api.setMinDuration(120);
+	const commands = api.getSendCommands();
+	check(commands.every((c) => c.duration === 250), "signal duration applies to the encoder");
+	check(api.feed(commands) >= 5, "array-of-objects feed");
+	check(new TextDecoder().decode(api.getVerifiedData()) === "Hello, IR!", "round trip at 250");
+
+	api.destroy();
+	console.log(failures === 0 ? "wasm smoke: ok" : `wasm smoke: ${failures} failed`);
+	process.exitCode = failures === 0 ? 0 : 1;
+};
+
+main().catch((error) => {
+	console.error(error);
+	process.exitCode = 1;
+});